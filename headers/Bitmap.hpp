@@ -28,6 +28,8 @@ public:
     Bitmap(unsigned w, unsigned h, Color c = Color::NONE)
     : w(w), h(h), pixels(w * h, c)
     {}
+    //! Copies the pixels of a view, e.g. a portion of another bitmap.
+    explicit Bitmap(const BitmapView& source);
 
     unsigned width() const
     {
@@ -56,16 +58,26 @@ public:
     //! This updates a pixel using the "over" alpha compositing operator, see:
     //! https://en.wikipedia.org/wiki/Alpha_compositing
     void blend_pixel(unsigned x, unsigned y, Color c);
+    //! Blends another bitmap onto this one, clipping it like insert() does. AM_DEFAULT uses
+    //! the same "over" operator as blend_pixel; AM_ADD and AM_MULTIPLY match what these modes
+    //! do when drawing with straight alpha, since bitmaps hold straight colors. AM_MULTIPLY
+    //! multiplies every channel, including alpha.
+    void blend(const BitmapView& source, int x, int y, AlphaMode mode = AM_DEFAULT);
+    //! Blends a single color onto a width * height rectangle at (x, y), with its alpha scaled
+    //! by one coverage byte per pixel, e.g. from a font rasterizer. Rows of coverage are stride
+    //! bytes apart.
+    void blend_mask(const std::uint8_t* coverage, unsigned stride, int x, int y,
+        unsigned width, unsigned height, Color c, AlphaMode mode = AM_DEFAULT);
     //! Inverts the current pixel, ignored if alpha value is 0.
     void invert_pixel(unsigned x, unsigned y);
     //! Inserts a bitmap at the given position. Parts of the inserted
     //! bitmap that would be outside of the target bitmap will be
     //! clipped away.
-    void insert(const Bitmap& source, int x, int y);
+    void insert(const BitmapView& source, int x, int y);
     //! Inserts a portion of a bitmap at the given position. Parts of the
     //! inserted bitmap that would be outside of the target bitmap will be
     //! clipped away.
-    void insert(const Bitmap& source, int x, int y, unsigned src_x, unsigned src_y,
+    void insert(const BitmapView& source, int x, int y, unsigned src_x, unsigned src_y,
         unsigned src_width, unsigned src_height);
     //! Direct access to the array of color values. May be useful for optimized
     //! OpenGL operations.
@@ -78,18 +90,100 @@ public:
       return &pixels[0];
     }
   };
+
+  //! Read-only reference to a rectangle of pixels that belong to somebody else, e.g. a portion
+  //! of a Bitmap. Views never allocate and are cheap to copy, but must not outlive the pixels.
+  //! Every Bitmap converts to a view of itself, so functions that only read pixels take views.
+  class BitmapView
+  {
+    const Color* pixels_;
+    unsigned w, h, stride_;
+
+  public:
+    BitmapView() : pixels_(nullptr), w(0), h(0), stride_(0) {}
+    //! \param stride Distance between the starts of two rows, in pixels.
+    BitmapView(const Color* pixels, unsigned width, unsigned height, unsigned stride)
+    : pixels_(pixels), w(width), h(height), stride_(stride)
+    {}
+    BitmapView(const Bitmap& bitmap)
+    : pixels_(bitmap.pixels.data()), w(bitmap.width()), h(bitmap.height()),
+      stride_(bitmap.width())
+    {}
+    //! Views a portion of a bitmap. Throws std::invalid_argument if it does not lie within the
+    //! bitmap.
+    BitmapView(const Bitmap& bitmap, unsigned x, unsigned y, unsigned width, unsigned height)
+    : BitmapView(BitmapView(bitmap).subview(x, y, width, height))
+    {}
+
+    unsigned width() const
+    {
+      return w;
+    }
+
+    unsigned height() const
+    {
+      return h;
+    }
+
+    unsigned stride() const
+    {
+      return stride_;
+    }
+    //! True if each row directly follows the previous one.
+    bool contiguous() const
+    {
+      return stride_ == w || h <= 1;
+    }
+
+    const Color* data() const
+    {
+      return pixels_;
+    }
+
+    const Color* row(unsigned y) const
+    {
+      return pixels_ + y * stride_;
+    }
+
+    Color get_pixel(unsigned x, unsigned y) const
+    {
+      return pixels_[y * stride_ + x];
+    }
+    //! Views a portion of this view. Throws std::invalid_argument if it does not lie within it.
+    BitmapView subview(unsigned x, unsigned y, unsigned width, unsigned height) const;
+  };
+  //! Flipping applies to the images that the calling thread loads afterwards. Horizontal
+  //! flipping only applies to the next image, including one requested from an ImageLoader or
+  //! with IF_LAZY, and then turns itself off again. Vertical flipping stays on.
   void enable_flip_h(bool flip_h);
   void enable_flip_y(bool flip_y);
   void enable_flip_h_y(bool flip_h, bool flip_y);
+  //! The flipping set for the calling thread, e.g. to pass on to a loader thread.
+  bool flip_h_enabled();
+  bool flip_y_enabled();
   void load_image_inverse_color(Bitmap& bitmap, const std::string& filename);
   //! Loads any supported image into a Bitmap.
   void load_image_file(Bitmap& bitmap, const std::string& filename);
+  //! Loads any supported image into a Bitmap, flipped as given instead of as set for the
+  //! calling thread.
+  void load_image_file(Bitmap& bitmap, const std::string& filename, bool flip_h, bool flip_y);
   //! Loads any supported image into a Bitmap.
   void load_image_file(Bitmap& bitmap, Reader input);
-  //! Saves a Bitmap to a file.
-  void save_image_file(const Bitmap& bitmap, const std::string& filename);
-  //! Saves a Bitmap to an arbitrary resource.
-  void save_image_file(const Bitmap& bitmap, Writer writer,
+  void load_image_file(Bitmap& bitmap, Reader input, bool flip_h, bool flip_y);
+  //! Makes load_image_file(bitmap, filename) keep the decoded pixels of each file in the given
+  //! directory, which must exist, and map them from there when a file with the same contents is
+  //! loaded again. Pass an empty string (the default) to turn the cache off again. Stale entries
+  //! are never deleted, so use a directory that the game owns.
+  void set_image_cache_directory(const std::string& directory);
+  //! Reads the size of an image file from its header, without decoding the pixels.
+  void load_image_size(const std::string& filename, unsigned& width, unsigned& height);
+  //! Saves a Bitmap, or a portion of one, to a file. The format depends on the extension: bmp,
+  //! tga, jpg/jpeg, qoi (lossless, and much faster than PNG), rgba (raw pixels after a 16-byte
+  //! header, fastest of all) or PNG for anything else. load_image_file reads all of them.
+  void save_image_file(const BitmapView& bitmap, const std::string& filename);
+  //! Saves a Bitmap, or a portion of one, to an arbitrary resource. format_hint is treated like
+  //! the extension of a filename.
+  void save_image_file(const BitmapView& bitmap, Writer writer,
     const std::string& format_hint = "png");
   void save_image_file(const std::string& filename, unsigned w, unsigned h, unsigned char*  data);
   //! Set the alpha value of all pixels which are equal to the color key
@@ -99,6 +193,35 @@ public:
   //! The reverse of apply_color_key. Resets all fully transparent pixels by
   //! a background color, makes all other pixels fully opaque.
   void unapply_color_key(Bitmap& bitmap, Color background);
-  void apply_border_flags(Bitmap& dest, const Bitmap& source, unsigned src_x, unsigned src_y,
+  enum ResampleFilter
+  {
+    //! Averages the source pixels that each target pixel covers. Keeps hard edges; good for
+    //! pixel art.
+    RF_BOX,
+    RF_BILINEAR,
+    //! Sharpest result for photos and painted art, at the cost of slight ringing near edges.
+    RF_LANCZOS
+  };
+  //! Returns a copy of source scaled to the given size. Transparent pixels do not affect the
+  //! colors of their neighbors.
+  Bitmap resample(const Bitmap& source, unsigned width, unsigned height,
+    ResampleFilter filter = RF_LANCZOS);
+  //! Shrinks a bitmap, keeping its aspect ratio, so that it fits into max_width * max_height.
+  //! Bitmaps that already fit are left alone.
+  void shrink_to_fit(Bitmap& bitmap, unsigned max_width, unsigned max_height,
+    ResampleFilter filter = RF_LANCZOS);
+  //! Inverts the red, green and blue channels of all pixels that are not fully transparent.
+  void invert_colors(Bitmap& bitmap);
+  //! Multiplies every pixel with a color, channel by channel, like Gosu::multiply.
+  void tint(Bitmap& bitmap, Color c);
+  //! Replaces the color of every pixel with its luminance, keeping its alpha.
+  void grayscale(Bitmap& bitmap);
+  void apply_border_flags(Bitmap& dest, const BitmapView& source, unsigned src_x, unsigned src_y,
     unsigned src_width, unsigned src_height, unsigned border_flags);
+  //! Like apply_border_flags, but writes the bordered portion into an existing bitmap, with its
+  //! upper left border pixel at (dest_x, dest_y). Border pixels of edges that are not tileable
+  //! are left untouched, so dest should be cleared to Color::NONE beforehand.
+  void apply_border_flags(Bitmap& dest, unsigned dest_x, unsigned dest_y, const BitmapView& source,
+    unsigned src_x, unsigned src_y, unsigned src_width, unsigned src_height,
+    unsigned border_flags);
 }
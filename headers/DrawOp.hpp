@@ -15,6 +15,8 @@ namespace Gosu
     RenderState render_state;
     // Only valid if render_state.tex_name != NO_TEXTURE
     GLfloat top, left, bottom, right;
+    // Passed to the retro shader program as the third texture coordinate; see TexChunk.
+    bool retro = false;
     // TODO: Merge with Gosu::ArrayVertex.
     struct Vertex
     {
@@ -85,21 +87,22 @@ namespace Gosu
       if (vertices_or_block_index == 2) glBegin(GL_LINES);
       else if (vertices_or_block_index == 3) glBegin(GL_TRIANGLES);
       else glBegin(GL_QUADS);
+      GLfloat r = retro ? 1 : 0;
       for (unsigned i = 0; i < vertices_or_block_index; i++) {
         glColor4ubv(reinterpret_cast<const GLubyte*>(&vertices[i].c));
         if (render_state.texture) {
           switch (i) {
           case 0:
-            glTexCoord2f(left, top);
+            glTexCoord3f(left, top, r);
             break;
           case 1:
-            glTexCoord2f(right, top);
+            glTexCoord3f(right, top, r);
             break;
           case 2:
-            glTexCoord2f(right, bottom);
+            glTexCoord3f(right, bottom, r);
             break;
           case 3:
-            glTexCoord2f(left, bottom);
+            glTexCoord3f(left, bottom, r);
             break;
           }
         }
@@ -118,6 +121,7 @@ namespace Gosu
         result[i].vertices[1] = vertices[i].y;
         result[i].vertices[2] = 0;
         result[i].color       = vertices[i].c.abgr();
+        result[i].tex_coords[2] = retro ? 1 : 0;
         apply_transform(*render_state.transform, result[i].vertices[0], result[i].vertices[1]);
       }
       RenderState va_render_state = render_state;
@@ -37,6 +37,15 @@ public:
     op.render_state.transform = &transform_stack.current();
     if (const ClipRect* cr = clip_rect_stack.maybe_effective_rect())
       op.render_state.clip_rect = *cr;
+    if (Graphics::premultiplied_alpha()) {
+      // With (ONE, ONE_MINUS_SRC_ALPHA), a source alpha of zero adds the color to the
+      // destination, so additive operations can be batched with normal ones.
+      for (int i = 0; i < op.vertices_or_block_index; ++i) {
+        op.vertices[i].c = premultiply(op.vertices[i].c);
+        if (op.render_state.mode == AM_ADD) op.vertices[i].c.set_alpha(0);
+      }
+      if (op.render_state.mode == AM_ADD) op.render_state.mode = AM_DEFAULT;
+    }
     ops.push_back(op);
   }
 
@@ -40,7 +40,7 @@ namespace Gosu
       return nullptr;
     }
 
-    virtual void insert(const Bitmap&, int x, int y) override
+    virtual void insert(const BitmapView&, int x, int y) override
     {}
 
     static const std::shared_ptr<EmptyImageData>& instance_ptr()
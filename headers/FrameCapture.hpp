@@ -0,0 +1,77 @@
+#pragma once
+
+#include "GraphicsImpl.hpp"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Copies finished frames out of the back buffer and encodes them on a background thread.
+// Frames are read into a ring of pixel buffer objects that are only mapped RING_SIZE frames
+// later, so that neither the readback nor the encoding stall the main loop.
+class Gosu::FrameCapture
+{
+  static const unsigned RING_SIZE = 3;
+  // If the encoder falls this far behind, capture() waits for it instead of dropping frames.
+  static const unsigned MAX_QUEUED_JOBS = 8;
+
+  struct VideoStream;
+
+  // A frame that has been read back, and where it should go.
+  struct Job
+  {
+    Bitmap frame;
+    std::vector<std::string> filenames;
+    std::shared_ptr<VideoStream> video;
+  };
+
+  // A readback that may still be in flight.
+  struct Slot
+  {
+    GLuint buffer = 0;
+    unsigned width = 0, height = 0;
+    bool pending = false;
+    // Only used without pixel buffer objects.
+    Bitmap frame;
+    std::vector<std::string> filenames;
+    std::shared_ptr<VideoStream> video;
+  };
+
+  Slot slots_[RING_SIZE];
+  unsigned next_slot_;
+  std::vector<std::string> stills_;
+  std::shared_ptr<VideoStream> video_;
+
+  std::thread encoder_;
+  std::mutex mutex_;
+  std::condition_variable job_added_, job_taken_;
+  std::deque<Job> jobs_;
+  bool stopping_;
+  std::string error_;
+
+  void finish(Slot& slot);
+  void encode_jobs();
+  void throw_encoder_error();
+
+public:
+  FrameCapture();
+  ~FrameCapture();
+
+  // Saves the next captured frame to the given file. The format depends on the extension.
+  void save_next_frame(const std::string& filename);
+  // Appends every captured frame to the given file. Files ending in .y4m are YUV4MPEG2 streams,
+  // all other files receive raw RGBA frames, top row first.
+  void start_recording(const std::string& filename, unsigned fps);
+  // Waits for all outstanding frames of the recording and closes the file.
+  void stop_recording();
+  bool recording() const { return video_ != nullptr; }
+
+  // Reads the back buffer after a frame has been drawn, and hands older frames to the encoder.
+  void capture(unsigned width, unsigned height);
+  // Hands all outstanding readbacks to the encoder.
+  void flush();
+};
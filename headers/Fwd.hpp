@@ -7,6 +7,7 @@
 namespace Gosu
 {
   class Bitmap;
+  class BitmapView;
   class Buffer;
   class Button;
   class Channel;
@@ -16,11 +17,14 @@ namespace Gosu
   class Graphics;
   class Image;
   class ImageData;
+  class ImageLoader;
+  class IndexedImage;
   class Input;
   class Reader;
   class Resource;
   class Sample;
   class Song;
+  class StreamingImage;
   class TextInput;
   class Window;
   class Writer;
@@ -17,11 +17,14 @@
 #include "Graphics.hpp"
 #include "Image.hpp"
 #include "ImageData.hpp"
+#include "ImageLoader.hpp"
+#include "IndexedImage.hpp"
 #include "Input.hpp"
 #include "Inspection.hpp"
 #include "IO.hpp"
 #include "Math.hpp"
 #include "Platform.hpp"
+#include "StreamingImage.hpp"
 #include "Text.hpp"
 #include "TextInput.hpp"
 #include "Timing.hpp"
@@ -8,15 +8,16 @@
 #include "GraphicsBase.hpp"
 #include <functional>
 #include <memory>
+#include <vector>
 
 namespace Gosu
 {
   struct DrawOp;
 
-  //! Returns the maximum size of an texture that will be allocated
-  //! internally by Gosu.
-  //! Useful when extending Gosu using OpenGL.
-  const unsigned MAX_TEXTURE_SIZE = 1024;
+  //! Deprecated: The size of the textures that Gosu used to allocate internally before the
+  //! size was chosen at runtime. It no longer describes anything that Gosu does; use
+  //! Graphics::texture_size() instead.
+  GOSU_DEPRECATED const unsigned MAX_TEXTURE_SIZE = 1024;
 
   //! Serves as the target of all drawing and provides primitive drawing
   //! functionality.
@@ -79,14 +80,38 @@ public:
                           ZPos z, AlphaMode mode = AM_DEFAULT);
     static void draw_rect(double x, double y, double width, double height,
                           Color c, ZPos z, AlphaMode mode = AM_DEFAULT);
+    //! Returns the width and height of the textures that Gosu packs images into.
+    //! This is the largest power of two that neither exceeds GL_MAX_TEXTURE_SIZE nor the limit
+    //! set with set_max_texture_size().
+    //! Useful when extending Gosu using OpenGL.
+    static unsigned texture_size();
+    //! Limits the size of textures allocated from now on. Each of these textures takes up
+    //! texture_size() * texture_size() * 4 bytes of video memory as soon as it is created, so
+    //! higher limits trade memory for fewer texture switches while drawing. Default: 2048, up
+    //! from the 1024 that Gosu used before (16 MB instead of 4 MB per texture).
+    static void set_max_texture_size(unsigned size);
+    //! Switches to premultiplied alpha: Textures store their colors multiplied by alpha, and
+    //! AM_DEFAULT and AM_ADD share one blend function, so that mixed sprites can be drawn in
+    //! the same batch. Must be called before any image is created.
+    static void set_premultiplied_alpha(bool enabled);
+    static bool premultiplied_alpha();
     //! For internal use only.
     void set_physical_resolution(unsigned physical_width, unsigned physical_height);
     //! For internal use only.
     static void schedule_draw_op(const DrawOp& op);
     //! Turns a portion of a bitmap into something that can be drawn on a Graphics object.
-    static std::unique_ptr<ImageData> create_image(const Bitmap& src,
+    static std::unique_ptr<ImageData> create_image(const BitmapView& src,
                                                    unsigned src_x,     unsigned src_y,
                                                    unsigned src_width, unsigned src_height,
                                                    unsigned image_flags);
+    //! Turns a grid of tiles_x * tiles_y tiles at the upper left of a bitmap into drawable
+    //! images, returned row by row. Unlike repeated calls to create_image, this uploads all
+    //! tiles that fit onto one texture at once.
+    static std::vector<std::unique_ptr<ImageData>> create_tiles(const BitmapView& src,
+                                                                unsigned tile_width,
+                                                                unsigned tile_height,
+                                                                unsigned tiles_x,
+                                                                unsigned tiles_y,
+                                                                unsigned image_flags);
   };
 }
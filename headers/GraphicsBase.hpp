@@ -62,6 +62,33 @@ namespace Gosu
     IF_RETRO           = 1 << 5,
     /*IF_FLIP_H          = 1 << 6,
     IF_FLIP_Y          = 1 << 7*/
+    //! Leave fully transparent borders out of the texture. The image keeps
+    //! its size and is drawn at the same place, but it takes up less texture
+    //! space. Trimmed images have no gl_tex_info(), and insert() throws
+    //! std::invalid_argument if it would put visible pixels into the
+    //! trimmed borders.
+    IF_TRIM            = 1 << 8,
+    //! Draw this image as a few rectangles that only cover its visible
+    //! pixels, instead of as one quad. Saves fill rate on large images with
+    //! big transparent areas.
+    IF_TIGHT_MESH      = 1 << 9,
+    //! Build mipmaps for this image, so that it looks smoother and draws
+    //! faster when scaled down a lot. Uses more texture space. Ignored on
+    //! OpenGL ES.
+    IF_MIPMAP          = 1 << 10,
+    //! Only keep the alpha channel of this image, at one byte per pixel. It
+    //! is drawn as if all of its pixels were white, so the color passed to
+    //! draw() tints it. Meant for glyphs and masks.
+    IF_ALPHA8          = 1 << 11,
+    //! Store this image at 16 bits per pixel without an alpha channel. Meant
+    //! for opaque backgrounds.
+    IF_RGB565          = 1 << 12,
+    //! Store this image at 16 bits per pixel, with four bits per channel.
+    IF_RGBA4444        = 1 << 13,
+    //! Only read the size of the image file when the image is created, and
+    //! decode and upload it when it is first used. Only has an effect on
+    //! images that are loaded from a whole file.
+    IF_LAZY            = 1 << 14
   };
 
   typedef std::array<double, 16> Transform;
@@ -14,8 +14,32 @@
 
 #include <algorithm>
 #include <list>
+#include <stdexcept>
 #include <vector>
 
+// Loads OpenGL functions that are not part of OpenGL 1.1 (or their OES counterparts) into a
+// static local variable. Expects 'using namespace std;'.
+#ifdef GOSU_IS_OPENGLES
+    #define GOSU_LOAD_GL_EXT(fn, type) \
+        static auto fn = fn ## OES;
+
+    #define GOSU_GL_CONST(name) \
+        name ## _OES
+
+    #define GOSU_GL_DEPTH_COMPONENT \
+        GL_DEPTH_COMPONENT16_OES
+#else
+    #define GOSU_LOAD_GL_EXT(fn, type) \
+        static auto fn = (type) SDL_GL_GetProcAddress(#fn); \
+        if (!fn) throw runtime_error("Unable to load " #fn);
+
+    #define GOSU_GL_CONST(name) \
+        name
+
+    #define GOSU_GL_DEPTH_COMPONENT \
+        GL_DEPTH_COMPONENT
+#endif
+
 namespace Gosu
 {
   struct RenderState;
@@ -23,6 +47,8 @@ namespace Gosu
 
   const GLuint NO_TEXTURE = static_cast<GLuint>(-1);
   const unsigned NO_CLIPPING = 0xffffffff;
+  // Palette id of draw operations that use the texture's colors as they are.
+  const int NO_PALETTE = -1;
 
   // In various places in Gosu, width==NO_CLIPPING by convention means
   // that no clipping should happen.
@@ -56,10 +82,13 @@ namespace Gosu
   typedef std::list<Transform> Transforms;
   typedef std::list<DrawOpQueue> DrawOpQueueStack;
   class LargeImageData;
+  class LazyImageData;
   class Macro;
+  class FrameCapture;
   struct ArrayVertex
   {
-    GLfloat tex_coords[2];
+    // The third coordinate selects retro sampling; see DrawOp.
+    GLfloat tex_coords[3];
     GLuint color;
     GLfloat vertices[3];
   };
@@ -106,6 +135,31 @@ namespace Gosu
 
   void ensure_current_context();
 
+  // Conversion between straight and premultiplied alpha; see Graphics::premultiplied_alpha().
+  inline Color premultiply(Color c)
+  {
+    unsigned a = c.alpha();
+    return Color(a, (c.red() * a + 127) / 255, (c.green() * a + 127) / 255,
+                 (c.blue() * a + 127) / 255);
+  }
+
+  inline Color unpremultiply(Color c)
+  {
+    unsigned a = c.alpha();
+    if (a == 0) return Color::NONE;
+    return Color(a, std::min(255u, (c.red() * 255 + a / 2) / a),
+                 std::min(255u, (c.green() * 255 + a / 2) / a),
+                 std::min(255u, (c.blue() * 255 + a / 2) / a));
+  }
+
+  // Switches to the palette lookup program for the given palette (see IndexedImage), to the retro
+  // program for NO_PALETTE on textures that hold retro images (see Texture::has_retro_images), or
+  // back to the fixed-function pipeline otherwise. The texture is the one about to be drawn.
+  void apply_shader_program(int palette, const Texture* texture);
+
+  // Builds the retro program on first use. False on OpenGL ES, or if the driver rejects it.
+  bool retro_program_available();
+
   inline std::string escape_markup(const std::string& text) {
     // Escape all markup and delegate to layout_markup.
     auto markup = text;
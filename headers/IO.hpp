@@ -210,6 +210,9 @@ namespace Gosu
     void resize(std::size_t new_size) override;
     void read(std::size_t offset, std::size_t length, void* dest_buffer) const override;
     void write(std::size_t offset, std::size_t length, const void* source_buffer) override;
+    //! The contents of a file that was opened with FM_READ, mapped into memory, or nullptr if
+    //! the file could not be mapped (e.g. because it is empty).
+    const void* data() const;
   };
 
   //! Loads a whole file into a buffer.
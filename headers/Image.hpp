@@ -25,15 +25,20 @@ namespace Gosu
     //! A color key of #ff00ff is automatically applied to BMP image files.
     //! For more flexibility, use the corresponding constructor that uses a Bitmap object.
     explicit Image(const std::string& filename, unsigned image_flags = IF_SMOOTH);
+    //! Loads an image and shrinks it, keeping its aspect ratio, so that it fits into max_width *
+    //! max_height before it takes up any video memory. Images with IF_RETRO are shrunk with a
+    //! box filter, all others with Lanczos. Images that already fit are not changed.
+    Image(const std::string& filename, unsigned max_width, unsigned max_height,
+      unsigned image_flags);
     //! Loads a portion of the the image at the given filename.
     //! A color key of #ff00ff is automatically applied to BMP image files.
     //! For more flexibility, use the corresponding constructor that uses a Bitmap object.
     Image(const std::string& filename, unsigned src_x, unsigned src_y,
       unsigned src_width, unsigned src_height, unsigned image_flags = IF_SMOOTH);
     //! Converts the given bitmap into an image.
-    explicit Image(const Bitmap& source, unsigned image_flags = IF_SMOOTH);
+    explicit Image(const BitmapView& source, unsigned image_flags = IF_SMOOTH);
     //! Converts a portion of the given bitmap into an image.
-    Image(const Bitmap& source, unsigned src_x, unsigned src_y, unsigned src_width,
+    Image(const BitmapView& source, unsigned src_x, unsigned src_y, unsigned src_width,
       unsigned src_height, unsigned image_flags = IF_SMOOTH);
     //! Creates an Image from a user-supplied instance of the ImageData interface.
     explicit Image(std::unique_ptr<ImageData>&& data);
@@ -56,6 +61,9 @@ namespace Gosu
     void draw_rot(double x, double y, ZPos z, double angle,
       double center_x = 0.5, double center_y = 0.5, double scale_x = 1, double scale_y = 1,
       Color c = Color::WHITE, AlphaMode mode = AM_DEFAULT) const;
+    //! Hints that the image will be drawn soon, so that an image with IF_LAZY is decoded in the
+    //! background rather than during its first draw.
+    void prefetch() const;
     #ifndef SWIG
     //! Provides access to the underlying image data object.
     ImageData& data() const;
@@ -66,7 +74,7 @@ namespace Gosu
   //! \param tile_width If positive, specifies the width of one tile in pixels.
   //! If negative, the bitmap is divided into -tile_width rows.
   //! \param tile_height See tile_width.
-  std::vector<Gosu::Image> load_tiles(const Bitmap& bmp,
+  std::vector<Gosu::Image> load_tiles(const BitmapView& bmp,
     int tile_width, int tile_height, unsigned image_flags = IF_SMOOTH);
   //! Convenience function that slices a bitmap into a grid and creates images from them.
   //! \param tile_width If positive, specifies the width of one tile in pixels.
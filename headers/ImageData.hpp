@@ -7,6 +7,7 @@
 #include "Color.hpp"
 #include "GraphicsBase.hpp"
 #include "Platform.hpp"
+#include <future>
 #include <memory>
 
 namespace Gosu
@@ -14,6 +15,11 @@ namespace Gosu
   //! Contains information about the underlying OpenGL texture and the
   //! u/v space used for image data. Can be retrieved from some images
   //! to use them in OpenGL operations.
+  //! Images, including tileable ones, usually share their texture with other
+  //! images, so left/right/top/bottom need not span 0..1, and GL_REPEAT
+  //! cannot be used to tile them; repeat the quad or wrap the coordinates
+  //! within that rectangle instead. Retro images on such a shared texture are
+  //! sampled with GL_LINEAR unless you switch the filter yourself.
   struct GLTexInfo
   {
     int tex_name;
@@ -39,9 +45,18 @@ namespace Gosu
       double x3, double y3, Color c3,
       double x4, double y4, Color c4,
       ZPos z, AlphaMode mode) const = 0;
+    //! Returns nullptr if the image does not consist of a single rectangle
+    //! on one texture. See GLTexInfo.
     virtual const GLTexInfo* gl_tex_info() const = 0;
     virtual Bitmap to_bitmap() const = 0;
+    //! Like to_bitmap(), but may only start reading the pixels back from the GPU and return
+    //! before they have arrived. Call get() on the result, or discard it, from the thread that
+    //! draws.
+    virtual std::future<Bitmap> to_bitmap_async() const;
+    //! Hints that the image will be drawn soon. Images that are not ready to be drawn yet, e.g.
+    //! with IF_LAZY, start preparing in the background. Does nothing by default.
+    virtual void prefetch() const {}
     virtual std::unique_ptr<ImageData> subimage(int x, int y, int width, int height) const = 0;
-    virtual void insert(const Bitmap& bitmap, int x, int y) = 0;
+    virtual void insert(const BitmapView& bitmap, int x, int y) = 0;
   };
 }
@@ -0,0 +1,53 @@
+//! \file ImageLoader.hpp
+//! Interface of the ImageLoader class.
+
+#pragma once
+
+#include "Fwd.hpp"
+#include "GraphicsBase.hpp"
+#include <future>
+#include <memory>
+#include <string>
+
+namespace Gosu
+{
+  //! Loads image files in the background, e.g. behind a loading screen. The files are decoded
+  //! in parallel on worker threads. Creating the images needs the OpenGL context, so that only
+  //! happens in update(), which must be called regularly (e.g. once per frame) from the thread
+  //! that draws.
+  class ImageLoader
+  {
+    struct Impl;
+    std::shared_ptr<Impl> pimpl;
+
+  public:
+    ImageLoader();
+    //! Images that have not been created yet are abandoned; their futures report
+    //! std::future_error.
+    ~ImageLoader();
+
+    //! Starts loading an image file. The future becomes ready during a later call to update()
+    //! or wait(). Errors, e.g. files that cannot be decoded, are rethrown by its get().
+    //! A color key of #ff00ff is automatically applied to BMP image files, and the images are
+    //! flipped as set with enable_flip_h/enable_flip_y on the calling thread.
+    std::shared_future<Image> load(const std::string& filename,
+      unsigned image_flags = IF_SMOOTH);
+    //! Like load(filename, image_flags), but flipped as given instead of as set for the calling
+    //! thread.
+    std::shared_future<Image> load(const std::string& filename, unsigned image_flags,
+      bool flip_h, bool flip_y);
+
+    //! Creates images from the files that have been decoded so far, until max_milliseconds
+    //! have passed. If an image is ready, at least one is created.
+    void update(double max_milliseconds = 2);
+    //! Blocks until all requested images have been created.
+    void wait();
+
+    //! Number of images that have been requested.
+    unsigned requested() const;
+    //! Number of images whose futures are ready, including ones that failed to load.
+    unsigned finished() const;
+    //! finished() / requested(), or 1 if nothing has been requested, for progress bars.
+    double progress() const;
+  };
+}
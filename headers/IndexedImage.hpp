@@ -0,0 +1,50 @@
+//! \file IndexedImage.hpp
+//! Interface of the IndexedImage class.
+
+#pragma once
+
+#include "Fwd.hpp"
+#include "Color.hpp"
+#include "GraphicsBase.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Gosu
+{
+  //! An image that stores one palette index per pixel instead of a color. The colors are only
+  //! looked up when the image is drawn, so the same image can be drawn with any number of
+  //! palettes without using more memory. Needs OpenGL 2.0; not supported on OpenGL ES.
+  class IndexedImage
+  {
+    std::shared_ptr<ImageData> data_;
+
+  public:
+    //! Number of colors in every palette.
+    static const unsigned PALETTE_SIZE = 256;
+    //! Maximum number of palettes that can exist at the same time.
+    static const unsigned MAX_PALETTES = 256;
+
+    //! Creates an image from one palette index per pixel, row by row.
+    //! \param image_flags Only the tileability flags are used.
+    IndexedImage(unsigned width, unsigned height, const std::vector<std::uint8_t>& indices,
+      unsigned image_flags = IF_SMOOTH);
+    //! Creates an image by looking up the color of each pixel in the given palette.
+    //! Throws std::invalid_argument if a color does not appear in the palette.
+    IndexedImage(const Bitmap& source, const std::vector<Color>& palette,
+      unsigned image_flags = IF_SMOOTH);
+    unsigned width() const;
+    unsigned height() const;
+    //! Draws the image with the colors of the given palette so that its upper left corner is
+    //! at (x; y).
+    void draw(double x, double y, ZPos z, unsigned palette, double scale_x = 1,
+      double scale_y = 1, Color c = Color::WHITE, AlphaMode mode = AM_DEFAULT) const;
+
+    //! Creates a new palette of up to PALETTE_SIZE colors and returns its id. Missing colors
+    //! are transparent.
+    static unsigned create_palette(const std::vector<Color>& colors);
+    //! Replaces the colors of an existing palette. This is cheap, and affects everything that
+    //! uses this palette, including draw calls that are still queued for the current frame.
+    static void set_palette(unsigned palette, const std::vector<Color>& colors);
+  };
+}
@@ -15,7 +15,7 @@ class Gosu::LargeImageData : public Gosu::ImageData
   LargeImageData() {}
 
 public:
-  LargeImageData(const Bitmap& source, int tile_width, int tile_height, unsigned image_flags);
+  LargeImageData(const BitmapView& source, int tile_width, int tile_height, unsigned image_flags);
   int width() const override  { return w; }
   int height() const override { return h; }
   void draw(double x1, double y1, Color c1,
@@ -26,5 +26,5 @@ public:
   const GLTexInfo* gl_tex_info() const override { return nullptr; }
   std::unique_ptr<ImageData> subimage(int x, int y, int width, int height) const override;
   Bitmap to_bitmap() const override;
-  void insert(const Bitmap& bitmap, int x, int y) override;
+  void insert(const BitmapView& bitmap, int x, int y) override;
 };
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "GraphicsImpl.hpp"
+#include "Bitmap.hpp"
+#include "Fwd.hpp"
+#include "ImageData.hpp"
+#include <future>
+#include <memory>
+#include <string>
+
+// Stands in for the image in a file until it is first used, see IF_LAZY. Only the size is read
+// up front; the file is decoded and put onto a texture by the first call that needs the pixels.
+class Gosu::LazyImageData : public Gosu::ImageData
+{
+  std::string filename;
+  unsigned image_flags;
+  // Flipping as set when the image was created, not when it is decoded.
+  bool flip_h, flip_y;
+  unsigned w, h;
+  // The file decoded by prefetch(), until it is used.
+  mutable std::future<Bitmap> decoded;
+  mutable std::unique_ptr<ImageData> data;
+
+  // Decodes and uploads the file unless that has already happened. Needs the OpenGL context.
+  ImageData& resolve() const;
+
+public:
+  LazyImageData(const std::string& filename, unsigned image_flags);
+  int width() const override  { return w; }
+  int height() const override { return h; }
+  void draw(double x1, double y1, Color c1,
+            double x2, double y2, Color c2,
+            double x3, double y3, Color c3,
+            double x4, double y4, Color c4,
+            ZPos z, AlphaMode mode) const override;
+  const GLTexInfo* gl_tex_info() const override;
+  Bitmap to_bitmap() const override;
+  std::future<Bitmap> to_bitmap_async() const override;
+  void prefetch() const override;
+  std::unique_ptr<ImageData> subimage(int x, int y, int width, int height) const override;
+  void insert(const BitmapView& bitmap, int x, int y) override;
+};
@@ -26,5 +26,5 @@ public:
     
     std::unique_ptr<ImageData> subimage(int x, int y, int width, int height) const override;
     
-    void insert(const Bitmap& bitmap, int x, int y) override;
+    void insert(const BitmapView& bitmap, int x, int y) override;
 };
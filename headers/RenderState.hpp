@@ -11,9 +11,11 @@ struct Gosu::RenderState
     const Transform* transform;
     ClipRect clip_rect;
     AlphaMode mode;
+    // Palette to look the texture's indices up in, or NO_PALETTE.
+    int palette;
     
     RenderState()
-    : transform(0), mode(AM_DEFAULT)
+    : transform(0), mode(AM_DEFAULT), palette(NO_PALETTE)
     {
         clip_rect.width = NO_CLIPPING;
     }
@@ -23,12 +25,14 @@ struct Gosu::RenderState
         return texture == rhs.texture &&
             transform == rhs.transform &&
             clip_rect == rhs.clip_rect &&
-            mode == rhs.mode;
+            mode == rhs.mode &&
+            palette == rhs.palette;
     }
     
     void apply_texture() const
     {
         if (texture) {
+            texture->flush();
             glEnable(GL_TEXTURE_2D);
             glBindTexture(GL_TEXTURE_2D, texture->tex_name());
         }
@@ -39,7 +43,16 @@ struct Gosu::RenderState
     
     void apply_alpha_mode() const
     {
-        if (mode == AM_ADD) {
+        if (Graphics::premultiplied_alpha()) {
+            // Additive blending is encoded in the vertex alpha instead; see DrawOpQueue.
+            if (mode == AM_MULTIPLY) {
+                glBlendFunc(GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA);
+            }
+            else {
+                glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            }
+        }
+        else if (mode == AM_ADD) {
             glBlendFunc(GL_SRC_ALPHA, GL_ONE);
         }
         else if (mode == AM_MULTIPLY) {
@@ -66,6 +79,7 @@ struct Gosu::RenderState
     void apply() const
     {
         apply_texture();
+        apply_shader_program(palette, texture.get());
         // TODO: No inner clip_rect yet - how would this work?!
         apply_alpha_mode();
     }
@@ -112,6 +126,8 @@ public:
         no_clipping.width = NO_CLIPPING;
         set_clip_rect(no_clipping);
         set_texture(std::shared_ptr<Texture>());
+        // Without a texture, this always returns to the fixed-function pipeline.
+        set_palette(NO_PALETTE, true);
         // Return to previous MV matrix
         glMatrixMode(GL_MODELVIEW);
         glPopMatrix();
@@ -119,7 +135,9 @@ public:
     
     void set_render_state(const RenderState& rs)
     {
+        bool texture_changed = (rs.texture != texture);
         set_texture(rs.texture);
+        set_palette(rs.palette, texture_changed);
         set_transform(rs.transform);
         set_clip_rect(rs.clip_rect);
         set_alpha_mode(rs.mode);
@@ -130,6 +148,8 @@ public:
         if (new_texture == texture) return;
 
         if (new_texture) {
+            // Inserts into the texture since the last flush must be visible in this draw.
+            new_texture->flush();
             if (!texture) {
                 glEnable(GL_TEXTURE_2D);
             }
@@ -142,6 +162,16 @@ public:
         texture = new_texture;
     }
     
+    void set_palette(int new_palette, bool texture_changed)
+    {
+        // The shader programs depend on the texture, too (its size and whether it holds retro
+        // images).
+        if (new_palette == palette && !texture_changed) return;
+        
+        palette = new_palette;
+        apply_shader_program(palette, texture.get());
+    }
+    
     void set_transform(const Transform* new_transform)
     {
         if (new_transform == transform) return;
@@ -186,6 +216,7 @@ public:
     void enforce_after_untrusted_gL() const
     {
         apply_texture();
+        apply_shader_program(palette, texture.get());
         apply_transform();
         apply_clip_rect();
         apply_alpha_mode();
@@ -0,0 +1,41 @@
+//! \file StreamingImage.hpp
+//! Interface of the StreamingImage class.
+
+#pragma once
+
+#include "Fwd.hpp"
+#include "Color.hpp"
+#include "GraphicsBase.hpp"
+#include <memory>
+
+namespace Gosu
+{
+  //! An image whose pixels are replaced often, e.g. once per frame by a video decoder or a
+  //! procedural animation. Unlike creating a new Image for every frame, this reuses one texture
+  //! and lets the caller write each frame straight into memory that OpenGL uploads from.
+  class StreamingImage
+  {
+    struct Impl;
+    std::unique_ptr<Impl> pimpl;
+
+  public:
+    //! \param image_flags Only IF_RETRO is used. The edges of a streaming image are always hard,
+    //! as if it was tileable.
+    StreamingImage(unsigned width, unsigned height, unsigned image_flags = IF_SMOOTH);
+    ~StreamingImage();
+
+    unsigned width() const;
+    unsigned height() const;
+
+    //! Returns memory for the next frame: width() * height() colors, row by row, starting at the
+    //! top. Every pixel must be written, because the memory does not hold the previous frame.
+    //! The pointer is valid until unlock() is called.
+    Color* lock();
+    //! Uploads the frame that was written since lock(). The new frame also shows up in draw
+    //! calls that are still queued for the current frame.
+    void unlock();
+
+    //! The image that shows the last frame that was unlocked.
+    const Image& image() const;
+  };
+}
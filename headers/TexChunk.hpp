@@ -5,28 +5,59 @@
 #include "ImageData.hpp"
 #include <memory>
 #include <stdexcept>
+#include <vector>
 
 class Gosu::TexChunk : public Gosu::ImageData
 {
   std::shared_ptr<Texture> texture;
   int x, y, w, h, padding;
+  // Whether this retro image shares a smooth texture, so that its draw operations must ask the
+  // retro shader program for nearest-neighbor sampling.
+  bool retro;
+  // Position of the stored rectangle within the image, and the size of the image including the
+  // transparent borders that were trimmed away. Without trimming, these are 0, 0, w, h.
+  int offset_x, offset_y, full_w, full_h;
+  // Rectangles relative to the stored part that together cover all of its visible pixels. If not
+  // empty, these are drawn instead of a single quad.
+  struct Part { int left, top, right, bottom; };
+  std::vector<Part> mesh;
   GLTexInfo info;
   void set_tex_info();
+  void draw_quad(double left, double top, double right, double bottom,
+      double x1, double y1, Color c1,
+      double x2, double y2, Color c2,
+      double x3, double y3, Color c3,
+      double x4, double y4, Color c4,
+      ZPos z, AlphaMode mode, int palette) const;
 
 public:
-  TexChunk(std::shared_ptr<Texture> texture, int x, int y, int w, int h, int padding);
+  TexChunk(std::shared_ptr<Texture> texture, int x, int y, int w, int h, int padding,
+           bool retro);
   TexChunk(const TexChunk& parent, int x, int y, int w, int h);
   ~TexChunk() override;
-  int width() const override  { return w; }
-  int height() const override { return h; }
+  // Marks this chunk as the opaque part of a larger, otherwise transparent image.
+  void set_trim(int offset_x, int offset_y, int full_w, int full_h);
+  bool trimmed() const { return offset_x != 0 || offset_y != 0 || w != full_w || h != full_h; }
+  // Derives the mesh from the alpha channel of the stored part, which starts at (src_x, src_y)
+  // in bmp. Leaves the mesh empty if it would not save much.
+  void build_mesh(const BitmapView& bmp, unsigned src_x, unsigned src_y);
+  int width() const override  { return full_w; }
+  int height() const override { return full_h; }
   GLuint tex_name() const { return info.tex_name; }
   void draw(double x1, double y1, Color c1,
       double x2, double y2, Color c2,
       double x3, double y3, Color c3,
       double x4, double y4, Color c4,
       ZPos z, AlphaMode mode) const override;
-  const GLTexInfo* gl_tex_info() const override { return &info; }
+  // Like draw(), but treats the chunk's alpha values as indices into the given palette.
+  void draw(double x1, double y1, Color c1,
+      double x2, double y2, Color c2,
+      double x3, double y3, Color c3,
+      double x4, double y4, Color c4,
+      ZPos z, AlphaMode mode, int palette) const;
+  const GLTexInfo* gl_tex_info() const override;
   std::unique_ptr<ImageData> subimage(int x, int y, int width, int height) const override;
   Gosu::Bitmap to_bitmap() const override;
-  void insert(const Bitmap& bitmap, int x, int y) override;
+  std::future<Gosu::Bitmap> to_bitmap_async() const override;
+  void insert(const BitmapView& bitmap, int x, int y) override;
 };
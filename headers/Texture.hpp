@@ -5,25 +5,106 @@
 #include "TexChunk.hpp"
 #include "Fwd.hpp"
 #include "Bitmap.hpp"
+#include <future>
 #include <memory>
 #include <vector>
 
 class Gosu::Texture : public std::enable_shared_from_this<Texture>
 {
   // BlockAllocator can't be copied or moved, so neither can Texture.
+  // In mipmapped textures, the allocator works in units of granularity() pixels, so that every
+  // block starts and ends on whole pixels on every level.
   BlockAllocator allocator_;
   GLuint tex_name_;
+  unsigned mip_levels_;
+  unsigned format_;
   bool retro_;
+  // Set once a retro image is packed onto this smooth texture; see try_alloc().
+  bool has_retro_images_;
+  // Framebuffer with this texture attached, created on the first readback.
+  mutable GLuint framebuffer_;
+  // Copy of level 0 in straight colors, created by the first replace(). From then on, every
+  // upload to level 0 writes through to it, so it is valid everywhere and the rectangles that
+  // replace() stages can be merged freely. Takes as much memory as the texture itself.
+  Bitmap shadow_;
+  // Rectangles of shadow_ that have not been uploaded yet. None of them overlap or touch.
+  std::vector<BlockAllocator::Block> dirty_;
+  static const unsigned MAX_DIRTY_RECTS = 16;
+
+  unsigned granularity() const { return 1u << (mip_levels_ - 1); }
+  // Returns whether a new chunk with these flags must be drawn with per-vertex retro sampling,
+  // and remembers that for has_retro_images().
+  bool marks_retro(unsigned image_flags);
+  bool alloc(unsigned width, unsigned height, BlockAllocator::Block& block);
+  // Uploads a portion of bmp, which holds straight (not premultiplied) colors, converting it to
+  // the texture's format and alpha mode.
+  void upload(const BitmapView& bmp, unsigned src_x, unsigned src_y,
+      unsigned x, unsigned y, unsigned width, unsigned height, int mip_level = 0);
+  // Like upload(), but leaves the alpha mode alone.
+  void upload_straight(const BitmapView& bmp, unsigned src_x, unsigned src_y,
+      unsigned x, unsigned y, unsigned width, unsigned height, int mip_level);
+  void fill(Color c, unsigned x, unsigned y, unsigned width, unsigned height);
+  // Derives all smaller levels from a level-0 bitmap that belongs at (x, y).
+  void upload_mipmaps(Bitmap level, unsigned x, unsigned y);
+  // Binds framebuffer_ for glReadPixels. Returns false if that is not possible, e.g. because the
+  // texture's format cannot be rendered to.
+  bool begin_readback(GLint& previous_framebuffer) const;
+  void end_readback(GLint previous_framebuffer) const;
+  // Turns pixels read back from the texture into what was uploaded.
+  void finish_readback(Bitmap& bitmap) const;
 
 public:
-  Texture(unsigned width, unsigned height, bool retro);
+  // Number of levels in mipmapped textures. Blocks and their padding are aligned to eight pixels
+  // so that the smallest level still has a one-pixel border around each image.
+  static const unsigned MIPMAP_LEVELS = 4;
+  // The image flags that select a storage format other than RGBA8. Textures only ever hold
+  // images with the same format flags.
+  static const unsigned FORMAT_FLAGS = IF_ALPHA8 | IF_RGB565 | IF_RGBA4444;
+
+  // Retro textures use nearest-neighbor magnification for everything on them. Smooth textures
+  // can still hold retro images where shares_retro_images() allows it.
+  Texture(unsigned width, unsigned height, unsigned mip_levels = 1, unsigned format = 0,
+      bool retro = false);
+  // Whether retro images can go onto smooth textures with the given mipmap levels and format.
+  // Their texels are then picked by the retro shader program, per vertex, so that drawing retro
+  // and smooth images from one texture does not switch any state in between. Mipmaps and
+  // alpha-only textures are not supported by that program.
+  static bool shares_retro_images(unsigned mip_levels, unsigned format);
   ~Texture();
   unsigned width() const;
   unsigned height() const;
   GLuint tex_name() const;
+  unsigned mip_levels() const;
+  unsigned format() const;
   bool retro() const;
-  std::unique_ptr<TexChunk> try_alloc(const Bitmap& bmp, unsigned padding);
+  bool has_retro_images() const;
+  // Allocates room for a portion of bmp plus padding on each side, and uploads it straight from
+  // bmp. The padding duplicates the portion's edges where image_flags asks for tileable edges,
+  // and is transparent otherwise.
+  std::unique_ptr<TexChunk> try_alloc(const BitmapView& bmp, unsigned src_x, unsigned src_y,
+      unsigned src_width, unsigned src_height, unsigned padding, unsigned image_flags);
+  // Uploads a sheet of tiles_x * tiles_y equally sized cells at once and returns one chunk per
+  // cell (row by row), or an empty vector if the sheet does not fit.
+  std::vector<std::unique_ptr<TexChunk>> try_alloc_tiles(const BitmapView& sheet,
+      unsigned tiles_x, unsigned tiles_y, unsigned padding, unsigned image_flags);
   void block(unsigned x, unsigned y, unsigned width, unsigned height);
   void free(unsigned x, unsigned y, unsigned width, unsigned height);
+  // Overwrites the pixels at (x, y) with a portion of bmp. The pixels are only copied into the
+  // shadow copy, and flush() uploads them later, merged into as few rectangles as possible.
+  void replace(const BitmapView& bmp, unsigned src_x, unsigned src_y,
+      unsigned x, unsigned y, unsigned width, unsigned height);
+  // Uploads all staged pixels. This must happen before the texture is drawn or read back. May
+  // change the texture binding.
+  void flush();
+  // Uploads all staged pixels and frees the shadow copy. Must be called before writing to the
+  // texture in any other way than through this class, e.g. by rendering into it.
+  void release_shadow();
+  // Rebuilds the smaller levels of a mipmapped texture after its level 0 has been changed.
+  void update_mipmaps(unsigned x, unsigned y, unsigned width, unsigned height);
   Bitmap to_bitmap(unsigned x, unsigned y, unsigned width, unsigned height) const;
+  // Starts reading back a rectangle into a pixel buffer object and returns right away. The
+  // future maps the buffer when get() is called, which must happen on the rendering thread. The
+  // buffer is deleted along with the future, so that must happen there, too.
+  std::future<Bitmap> to_bitmap_async(unsigned x, unsigned y,
+      unsigned width, unsigned height) const;
 };
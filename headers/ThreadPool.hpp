@@ -0,0 +1,18 @@
+#pragma once
+
+#include <functional>
+
+namespace Gosu
+{
+  // Calls f(begin, end) for disjoint ranges that together cover [0; count), spread over a shared
+  // pool of worker threads and the calling thread, and returns once all of them are done.
+  // Ranges are at least min_chunk long, so small jobs stay on the calling thread. Exceptions
+  // thrown by f are rethrown here. Queued background tasks do not hold this up: Ranges go before
+  // them, and the calling thread takes over the ranges that no worker has started yet.
+  void parallel_for(unsigned count, unsigned min_chunk,
+                    const std::function<void (unsigned begin, unsigned end)>& f);
+
+  // Runs f on one of the worker threads. f must not throw. Tasks that have not started when the
+  // program exits are dropped.
+  void run_in_background(std::function<void ()> f);
+}
@@ -49,7 +49,16 @@ namespace Gosu
     void set_update_interval(double update_interval);
     std::string caption() const;
     void set_caption(const std::string& caption);
+    //! Saves the next frame to Screenshots/shot_<date>_<time>.<format>. The file is written on
+    //! a background thread, so it may not exist yet when this returns. "qoi" is lossless like
+    //! "png", but much cheaper to encode.
     void save_screenshot(const std::string& format);
+    //! Writes every frame to a video file until stop_recording() is called. Files ending in .y4m
+    //! are YUV4MPEG2 streams that most video tools can read; all other files receive raw RGBA
+    //! frames, top row first.
+    void start_recording(const std::string& filename);
+    void stop_recording();
+    bool recording() const;
     //! Enters a modal loop where the Window is visible on screen and
     //! receives calls to draw, update etc.
     virtual void show();
@@ -443,6 +443,7 @@ STBIDEF void stbi_set_unpremultiply_on_load(int flag_true_if_should_unpremultipl
 STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 
 // flip the image vertically, so the first pixel in the output array is the bottom left
+// (Gosu: these only affect images loaded on the calling thread)
 STBIDEF void stbi_kyon_set_flip_horizontally_on_load(int flag_true_if_should_flip);
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
@@ -525,6 +526,26 @@ STBIDEF int   stbi_zlib_decode_noheader_buffer(char *obuffer, int olen, const ch
 #define STBI_ASSERT(x) assert(x)
 #endif
 
+// Gosu: the failure reason and the flip flags are per thread, so that images can be decoded on
+// several threads at once.
+#ifndef STBI_THREAD_LOCAL
+   #if defined(__cplusplus) &&  __cplusplus >= 201103L
+      #define STBI_THREAD_LOCAL       thread_local
+   #elif defined(__GNUC__) && __GNUC__ < 5
+      #define STBI_THREAD_LOCAL       __thread
+   #elif defined(_MSC_VER)
+      #define STBI_THREAD_LOCAL       __declspec(thread)
+   #elif defined (__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+      #define STBI_THREAD_LOCAL       _Thread_local
+   #endif
+
+   #ifndef STBI_THREAD_LOCAL
+      #if defined(__GNUC__)
+        #define STBI_THREAD_LOCAL       __thread
+      #endif
+   #endif
+#endif
+
 
 #ifndef _MSC_VER
    #ifdef __cplusplus
@@ -840,8 +861,12 @@ static void    *stbi__pnm_load(stbi__context *s, int *x, int *y, int *comp, int
 static int      stbi__pnm_info(stbi__context *s, int *x, int *y, int *comp);
 #endif
 
+#ifndef STBI_THREAD_LOCAL
 // this is not threadsafe
 static const char *stbi__g_failure_reason;
+#else
+static STBI_THREAD_LOCAL const char *stbi__g_failure_reason;
+#endif
 
 STBIDEF const char *stbi_failure_reason(void)
 {
@@ -962,14 +987,22 @@ static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp);
 static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp);
 #endif
 
+#ifndef STBI_THREAD_LOCAL
 static int stbi_kyon_horizontally_flip_on_load = 0;
+#else
+static STBI_THREAD_LOCAL int stbi_kyon_horizontally_flip_on_load = 0;
+#endif
 
 STBIDEF void stbi_kyon_set_flip_horizontally_on_load(int flag_true_if_should_flip)
 {
   stbi_kyon_horizontally_flip_on_load = flag_true_if_should_flip;
 }
 
+#ifndef STBI_THREAD_LOCAL
 static int stbi__vertically_flip_on_load = 0;
+#else
+static STBI_THREAD_LOCAL int stbi__vertically_flip_on_load = 0;
+#endif
 
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
 {
@@ -1,9 +1,208 @@
 #include "Bitmap.hpp"
+#include "ThreadPool.hpp"
 #include <cassert>
 #include <algorithm>
+#include <cstring>
+#include <stdexcept>
 #include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 using namespace std;
 
+namespace Gosu
+{
+  namespace
+  {
+    // Clips the rectangle (src_x, src_y, width, height) that is to be drawn at (x, y) against a
+    // bitmap of the given size. Returns false if nothing is left.
+    bool clip(int& x, int& y, unsigned& src_x, unsigned& src_y, unsigned& width,
+              unsigned& height, unsigned dest_width, unsigned dest_height)
+    {
+      if (x < 0) {
+        unsigned clip_left = -x;
+        if (clip_left >= width) return false;
+        src_x += clip_left;
+        width -= clip_left;
+        x = 0;
+      }
+      if (y < 0) {
+        unsigned clip_top = -y;
+        if (clip_top >= height) return false;
+        src_y += clip_top;
+        height -= clip_top;
+        y = 0;
+      }
+      if (static_cast<unsigned>(x) >= dest_width || static_cast<unsigned>(y) >= dest_height)
+        return false;
+      width = min(width, dest_width - x);
+      height = min(height, dest_height - y);
+      return width > 0 && height > 0;
+    }
+
+    // floor(x / 255), exact for all products of two channels.
+    inline unsigned div255(unsigned x)
+    {
+      return (x + 1 + (x >> 8)) >> 8;
+    }
+
+#ifdef __SSE2__
+    // div255 on eight 16-bit lanes.
+    inline __m128i div255(__m128i x)
+    {
+      __m128i one = _mm_set1_epi16(1);
+      return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, one), _mm_srli_epi16(x, 8)), 8);
+    }
+
+    // Copies the alpha lane of each of the two pixels in x into all four of its lanes.
+    inline __m128i broadcast_alpha(__m128i x)
+    {
+      return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xff), 0xff);
+    }
+#endif
+
+    // The "over" operator. Straight colors keep this from being vectorized, but opaque and
+    // transparent pixels, which are the most common, avoid the divisions.
+    void blend_over(Color* dest, const Color* src, unsigned n)
+    {
+      for (unsigned i = 0; i < n; ++i) {
+        Color c = src[i];
+        if (c.alpha() == 0) continue;
+        Color& out = dest[i];
+        if (c.alpha() == 255 || out.alpha() == 0) {
+          out = c;
+        }
+        else if (out.alpha() == 255) {
+          unsigned inv_alpha = 255 - c.alpha();
+          out.set_red  (div255(c.red()   * c.alpha() + out.red()   * inv_alpha));
+          out.set_green(div255(c.green() * c.alpha() + out.green() * inv_alpha));
+          out.set_blue (div255(c.blue()  * c.alpha() + out.blue()  * inv_alpha));
+        }
+        else {
+          int inv_alpha = out.alpha() * (255 - c.alpha()) / 255;
+          out.set_alpha(c.alpha() + inv_alpha);
+          out.set_red  ((c.red()   * c.alpha() + out.red()   * inv_alpha) / out.alpha());
+          out.set_green((c.green() * c.alpha() + out.green() * inv_alpha) / out.alpha());
+          out.set_blue ((c.blue()  * c.alpha() + out.blue()  * inv_alpha) / out.alpha());
+        }
+      }
+    }
+
+    // Like glBlendFunc(GL_SRC_ALPHA, GL_ONE), which AM_ADD uses on the screen.
+    void blend_add(Color* dest, const Color* src, unsigned n)
+    {
+      unsigned i = 0;
+#ifdef __SSE2__
+      __m128i zero = _mm_setzero_si128();
+      for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + i));
+        __m128i lo = _mm_unpacklo_epi8(s, zero), hi = _mm_unpackhi_epi8(s, zero);
+        lo = div255(_mm_mullo_epi16(lo, broadcast_alpha(lo)));
+        hi = div255(_mm_mullo_epi16(hi, broadcast_alpha(hi)));
+        d = _mm_adds_epu8(d, _mm_packus_epi16(lo, hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), d);
+      }
+#endif
+      for (; i < n; ++i) {
+        Color c = src[i];
+        Color& out = dest[i];
+        out.set_red  (min(255u, out.red()   + div255(c.red()   * c.alpha())));
+        out.set_green(min(255u, out.green() + div255(c.green() * c.alpha())));
+        out.set_blue (min(255u, out.blue()  + div255(c.blue()  * c.alpha())));
+        out.set_alpha(min(255u, out.alpha() + div255(c.alpha() * c.alpha())));
+      }
+    }
+
+    // Like glBlendFunc(GL_DST_COLOR, GL_ZERO), which AM_MULTIPLY uses on the screen with
+    // straight alpha, like bitmaps have. Every channel, including alpha, is multiplied, so the
+    // source's alpha does not weaken the effect.
+    void blend_multiply(Color* dest, const Color* src, unsigned n)
+    {
+      unsigned i = 0;
+#ifdef __SSE2__
+      __m128i zero = _mm_setzero_si128();
+      for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + i));
+        __m128i lo = div255(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero),
+                                            _mm_unpacklo_epi8(d, zero)));
+        __m128i hi = div255(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero),
+                                            _mm_unpackhi_epi8(d, zero)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packus_epi16(lo, hi));
+      }
+#endif
+      for (; i < n; ++i) {
+        Color c = src[i];
+        Color& out = dest[i];
+        out.set_red  (div255(c.red()   * out.red()));
+        out.set_green(div255(c.green() * out.green()));
+        out.set_blue (div255(c.blue()  * out.blue()));
+        out.set_alpha(div255(c.alpha() * out.alpha()));
+      }
+    }
+
+    void blend_span(Color* dest, const Color* src, unsigned n, AlphaMode mode)
+    {
+      switch (mode) {
+        case AM_ADD:      blend_add(dest, src, n); break;
+        case AM_MULTIPLY: blend_multiply(dest, src, n); break;
+        default:          blend_over(dest, src, n); break;
+      }
+    }
+
+    // Bitmaps with fewer rows per thread than this are processed on the calling thread.
+    const unsigned MIN_ROWS_PER_THREAD = 64;
+
+    // Calls f(row, width) for every row of the bitmap, in bands of rows on several threads.
+    template<typename F>
+    void for_each_row(Bitmap& bitmap, F f)
+    {
+      unsigned width = bitmap.width();
+      Color* data = bitmap.data();
+      parallel_for(bitmap.height(), MIN_ROWS_PER_THREAD, [&](unsigned begin, unsigned end) {
+        for (unsigned y = begin; y < end; ++y) f(data + y * width, width);
+      });
+    }
+
+    // Replaces the keyed pixels of one row, given the original colors of the row and of the rows
+    // above and below it (nullptr at the edges of the bitmap).
+    void apply_color_key_to_row(Color* row, const Color* original, const Color* above,
+                                const Color* below, unsigned width, Color key)
+    {
+      for (unsigned x = 0; x < width; ++x) {
+        if (original[x] != key) continue;
+        unsigned red = 0, green = 0, blue = 0, count = 0;
+        auto add = [&](Color c) {
+          if (c == key) return;
+          red   += c.red();
+          green += c.green();
+          blue  += c.blue();
+          ++count;
+        };
+        if (x > 0) add(original[x - 1]);
+        if (x < width - 1) add(original[x + 1]);
+        if (above) add(above[x]);
+        if (below) add(below[x]);
+        row[x] = count ? Color(0, red / count, green / count, blue / count) : Color::NONE;
+      }
+    }
+  }
+}
+
+Gosu::Bitmap::Bitmap(const BitmapView& source)
+: w(source.width()), h(source.height())
+{
+  if (source.contiguous()) {
+    pixels.assign(source.data(), source.data() + w * h);
+  }
+  else {
+    pixels.reserve(w * h);
+    for (unsigned y = 0; y < h; ++y)
+      pixels.insert(pixels.end(), source.row(y), source.row(y) + w);
+  }
+}
+
 void Gosu::Bitmap::swap(Bitmap& other)
 {
   std::swap(pixels, other.pixels);
@@ -21,18 +220,36 @@ void Gosu::Bitmap::resize(unsigned width, unsigned height, Color c)
 
 void Gosu::Bitmap::blend_pixel(unsigned x, unsigned y, Color c)
 {
-  if (c.alpha() == 0) return;
-  Color out = get_pixel(x, y);
-  if (out.alpha() == 0) {
-    set_pixel(x, y, c);
-    return;
+  blend_over(&pixels[y * w + x], &c, 1);
+}
+
+void Gosu::Bitmap::blend(const BitmapView& source, int x, int y, AlphaMode mode)
+{
+  unsigned src_x = 0, src_y = 0, width = source.width(), height = source.height();
+  if (!clip(x, y, src_x, src_y, width, height, w, h)) return;
+  for (unsigned rel_y = 0; rel_y < height; ++rel_y)
+    blend_span(data() + (y + rel_y) * w + x, source.row(src_y + rel_y) + src_x, width, mode);
+}
+
+void Gosu::Bitmap::blend_mask(const uint8_t* coverage, unsigned stride, int x, int y,
+  unsigned width, unsigned height, Color c, AlphaMode mode)
+{
+  unsigned src_x = 0, src_y = 0;
+  if (!clip(x, y, src_x, src_y, width, height, w, h)) return;
+  // Expand the coverage into colors in chunks, so that the same span kernels can be used.
+  Color colors[64];
+  for (unsigned rel_y = 0; rel_y < height; ++rel_y) {
+    const uint8_t* mask = coverage + (src_y + rel_y) * stride + src_x;
+    Color* dest = data() + (y + rel_y) * w + x;
+    for (unsigned start = 0; start < width; start += 64) {
+      unsigned n = min(64u, width - start);
+      for (unsigned i = 0; i < n; ++i) {
+        colors[i] = c;
+        colors[i].set_alpha(div255(mask[start + i] * c.alpha()));
+      }
+      blend_span(dest + start, colors, n, mode);
+    }
   }
-  int inv_alpha = out.alpha() * (255 - c.alpha()) / 255;
-  out.set_alpha(c.alpha() + inv_alpha);
-  out.set_red  ((c.red()   * c.alpha() + out.red()   * inv_alpha) / out.alpha());
-  out.set_green((c.green() * c.alpha() + out.green() * inv_alpha) / out.alpha());
-  out.set_blue ((c.blue()  * c.alpha() + out.blue()  * inv_alpha) / out.alpha());
-  set_pixel(x, y, out);
 }
 
 void Gosu::Bitmap::invert_pixel(unsigned x, unsigned y)
@@ -41,119 +258,197 @@ void Gosu::Bitmap::invert_pixel(unsigned x, unsigned y)
   if (c.alpha() > 0) set_pixel(x, y, c.invert());
 }
 
-void Gosu::Bitmap::insert(const Bitmap& source, int x, int y)
+void Gosu::Bitmap::insert(const BitmapView& source, int x, int y)
 {
   insert(source, x, y, 0, 0, source.width(), source.height());
 }
 
-void Gosu::Bitmap::insert(const Bitmap& source, int x, int y,
+void Gosu::Bitmap::insert(const BitmapView& source, int x, int y,
   unsigned src_x, unsigned src_y, unsigned src_width, unsigned src_height)
 {
-  // TODO: This should use memcpy if possible (x == 0 && src_width == this->width())
-  if (x < 0) {
-    unsigned clip_left = -x;
-    if (clip_left >= src_width) return;
-    src_x += clip_left;
-    src_width -= clip_left;
-    x = 0;
+  if (!clip(x, y, src_x, src_y, src_width, src_height, w, h)) return;
+
+  const Color* src = source.row(src_y) + src_x;
+  unsigned src_stride = source.stride();
+  Color* dest = data() + y * w + x;
+  if (src >= pixels.data() && src < pixels.data() + pixels.size()) {
+    // The source is a view of this bitmap, so the rectangles may overlap; copy rows in an
+    // order that reads each one before it is overwritten.
+    if (dest > src) {
+      for (unsigned rel_y = src_height; rel_y-- > 0;)
+        memmove(dest + rel_y * w, src + rel_y * src_stride, src_width * sizeof(Color));
+    }
+    else {
+      for (unsigned rel_y = 0; rel_y < src_height; ++rel_y)
+        memmove(dest + rel_y * w, src + rel_y * src_stride, src_width * sizeof(Color));
+    }
   }
-  if (y < 0) {
-    unsigned clip_top = -y;
-    if (clip_top >= src_height) return;
-    src_y += clip_top;
-    src_height -= clip_top;
-    y = 0;
+  else if (src_width == w && src_width == src_stride) {
+    // Whole rows on both sides are one contiguous block.
+    memcpy(dest, src, src_width * src_height * sizeof(Color));
   }
-  if (x + src_width > w) {
-    if (static_cast<unsigned>(x) >= w) return;
-    src_width = w - x;
+  else if (src_width == 1) {
+    // Columns, e.g. the left and right borders of apply_border_flags.
+    for (unsigned rel_y = 0; rel_y < src_height; ++rel_y)
+      dest[rel_y * w] = src[rel_y * src_stride];
   }
-  if (y + src_height > h) {
-    if (static_cast<unsigned>(y) >= h) return;
-    src_height = h - y;
+  else {
+    for (unsigned rel_y = 0; rel_y < src_height; ++rel_y)
+      memcpy(dest + rel_y * w, src + rel_y * src_stride, src_width * sizeof(Color));
   }
-  for (unsigned rel_y = 0; rel_y < src_height; ++rel_y)
-    for (unsigned rel_x = 0; rel_x < src_width; ++rel_x)
-      set_pixel(x + rel_x, y + rel_y, source.get_pixel(src_x + rel_x, src_y + rel_y));
+}
+
+Gosu::BitmapView Gosu::BitmapView::subview(unsigned x, unsigned y, unsigned width,
+  unsigned height) const
+{
+  if (x > w || y > h || width > w - x || height > h - y)
+    throw invalid_argument("Rectangle does not lie within the bitmap");
+  return BitmapView(pixels_ + y * stride_ + x, width, height, stride_);
 }
 
 void Gosu::apply_color_key(Bitmap& bitmap, Color key)
 {
-  vector<Color> surrounding_colors;
-  surrounding_colors.reserve(4);
-  for (unsigned y = 0; y < bitmap.height(); ++y) {
-    for (unsigned x = 0; x < bitmap.width(); ++x) {
-      if (bitmap.get_pixel(x, y) == key) {
-        surrounding_colors.clear();
-        if (x > 0 && bitmap.get_pixel(x - 1, y) != key)
-          surrounding_colors.push_back(bitmap.get_pixel(x - 1, y));
-        if (x < bitmap.width() - 1 && bitmap.get_pixel(x + 1, y) != key)
-          surrounding_colors.push_back(bitmap.get_pixel(x + 1, y));
-        if (y > 0 && bitmap.get_pixel(x, y - 1) != key)
-          surrounding_colors.push_back(bitmap.get_pixel(x, y - 1));
-        if (y < bitmap.height() - 1 && bitmap.get_pixel(x, y + 1) != key)
-          surrounding_colors.push_back(bitmap.get_pixel(x, y + 1));
-        if (surrounding_colors.empty()) {
-          bitmap.set_pixel(x, y, Color::NONE);
-          continue;
-        }
-        unsigned red = 0, green = 0, blue = 0;
-        for (auto& color : surrounding_colors) {
-          red   += color.red();
-          green += color.green();
-          blue  += color.blue();
-        }
-        bitmap.set_pixel(x, y, Color(0,
-          red   / surrounding_colors.size(),
-          green / surrounding_colors.size(),
-          blue  / surrounding_colors.size() ) );
+  if (find(bitmap.pixels.begin(), bitmap.pixels.end(), key) == bitmap.pixels.end()) return;
+  // Neighbors are looked at with their original colors, so that bands of rows can be processed
+  // independently. The rows just above and below each band belong to other bands, so they are
+  // copied before any band starts. Within a band, only the row above the current one has
+  // already been overwritten, so a copy of that is kept while going down.
+  unsigned width = bitmap.width(), height = bitmap.height();
+  Color* data = bitmap.data();
+  unsigned bands = (height + MIN_ROWS_PER_THREAD - 1) / MIN_ROWS_PER_THREAD;
+  vector<Color> edges(bands * 2 * width);
+  for (unsigned band = 0; band < bands; ++band) {
+    unsigned begin = band * MIN_ROWS_PER_THREAD;
+    unsigned end = min(height, begin + MIN_ROWS_PER_THREAD);
+    if (begin > 0)
+      copy(data + (begin - 1) * width, data + begin * width, &edges[band * 2 * width]);
+    if (end < height)
+      copy(data + end * width, data + (end + 1) * width, &edges[(band * 2 + 1) * width]);
+  }
+  parallel_for(bands, 1, [&](unsigned first_band, unsigned last_band) {
+    vector<Color> above(width), current(width);
+    for (unsigned band = first_band; band < last_band; ++band) {
+      unsigned begin = band * MIN_ROWS_PER_THREAD;
+      unsigned end = min(height, begin + MIN_ROWS_PER_THREAD);
+      const Color* above_row = begin > 0 ? &edges[band * 2 * width] : nullptr;
+      for (unsigned y = begin; y < end; ++y) {
+        Color* row = data + y * width;
+        copy(row, row + width, current.begin());
+        const Color* below_row = y + 1 < end ? row + width
+                               : end < height ? &edges[(band * 2 + 1) * width] : nullptr;
+        apply_color_key_to_row(row, current.data(), above_row, below_row, width, key);
+        above.swap(current);
+        above_row = above.data();
       }
     }
-  }
+  });
 }
 
 void Gosu::unapply_color_key(Bitmap& bitmap, Color color)
 {
-  Color* p = bitmap.data();
-  for (int i = bitmap.width() * bitmap.height(); i > 0; --i, ++p) {
-    if (p->alpha() == 0)
-      *p = color;
-    else
-      p->set_alpha(255);
-  }
+  for_each_row(bitmap, [color](Color* p, unsigned width) {
+    for (unsigned x = 0; x < width; ++x) {
+      if (p[x].alpha() == 0)
+        p[x] = color;
+      else
+        p[x].set_alpha(255);
+    }
+  });
 }
 
-void Gosu::apply_border_flags(Bitmap& dest, const Bitmap& source, unsigned src_x, unsigned src_y,
+void Gosu::invert_colors(Bitmap& bitmap)
+{
+  for_each_row(bitmap, [](Color* p, unsigned width) {
+    unsigned x = 0;
+#ifdef __SSE2__
+    // x86 is little-endian, so red, green and blue are the low three bytes of each pixel.
+    __m128i alpha_mask = _mm_set1_epi32(0xff000000), rgb_mask = _mm_set1_epi32(0x00ffffff);
+    for (; x + 4 <= width; x += 4) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x));
+      __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(v, alpha_mask), _mm_setzero_si128());
+      v = _mm_xor_si128(v, _mm_andnot_si128(transparent, rgb_mask));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + x), v);
+    }
+#endif
+    for (; x < width; ++x) {
+      if (p[x].alpha() > 0) p[x] = p[x].invert();
+    }
+  });
+}
+
+void Gosu::tint(Bitmap& bitmap, Color c)
+{
+  for_each_row(bitmap, [c](Color* p, unsigned width) {
+    unsigned x = 0;
+#ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128();
+    __m128i color = _mm_unpacklo_epi8(_mm_set1_epi32(c.gl()), zero);
+    __m128i half = _mm_set1_epi16(127);
+    for (; x + 4 <= width; x += 4) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + x));
+      __m128i lo = div255(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), color), half));
+      __m128i hi = div255(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), color), half));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + x), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    // Rounds like Gosu::multiply.
+    for (; x < width; ++x) {
+      p[x] = Color(div255(p[x].alpha() * c.alpha() + 127), div255(p[x].red()   * c.red()   + 127),
+                   div255(p[x].green() * c.green() + 127), div255(p[x].blue()  * c.blue()  + 127));
+    }
+  });
+}
+
+void Gosu::grayscale(Bitmap& bitmap)
+{
+  for_each_row(bitmap, [](Color* p, unsigned width) {
+    // BT.601 weights in 8-bit fixed point; simple enough for the compiler to vectorize.
+    for (unsigned x = 0; x < width; ++x) {
+      unsigned luma = (77 * p[x].red() + 150 * p[x].green() + 29 * p[x].blue()) >> 8;
+      p[x] = Color(p[x].alpha(), luma, luma, luma);
+    }
+  });
+}
+
+void Gosu::apply_border_flags(Bitmap& dest, const BitmapView& source,
+                              unsigned src_x, unsigned src_y,
+                              unsigned src_width, unsigned src_height, unsigned image_flags)
+{
+  dest.resize(src_width + 2, src_height + 2);
+  apply_border_flags(dest, 0, 0, source, src_x, src_y, src_width, src_height, image_flags);
+}
+
+void Gosu::apply_border_flags(Bitmap& dest, unsigned dest_x, unsigned dest_y,
+                              const BitmapView& source, unsigned src_x, unsigned src_y,
                               unsigned src_width, unsigned src_height, unsigned image_flags)
 { // Backward compatibility: This used to be 'bool tileable'.
   if (image_flags == 1) image_flags = IF_TILEABLE;
-  dest.resize(src_width + 2, src_height + 2);
+  unsigned right = dest_x + src_width + 1, bottom = dest_y + src_height + 1;
   // The borders are made "harder" by duplicating the original bitmap's borders.
   // Top.
   if (image_flags & IF_TILEABLE_TOP)
-    dest.insert(source, 1, 0, src_x, src_y, src_width, 1);
+    dest.insert(source, dest_x + 1, dest_y, src_x, src_y, src_width, 1);
   // Bottom.
   if (image_flags & IF_TILEABLE_BOTTOM)
-    dest.insert(source, 1, dest.height() - 1, src_x, src_y + src_height - 1, src_width, 1);
+    dest.insert(source, dest_x + 1, bottom, src_x, src_y + src_height - 1, src_width, 1);
   // Left.
   if (image_flags & IF_TILEABLE_LEFT)
-    dest.insert(source, 0, 1, src_x, src_y, 1, src_height);
+    dest.insert(source, dest_x, dest_y + 1, src_x, src_y, 1, src_height);
   // Right.
   if (image_flags & IF_TILEABLE_RIGHT)
-    dest.insert(source, dest.width() - 1, 1, src_x + src_width - 1, src_y, 1, src_height);
+    dest.insert(source, right, dest_y + 1, src_x + src_width - 1, src_y, 1, src_height);
   // Top left.
   if ((image_flags & IF_TILEABLE_TOP) && (image_flags & IF_TILEABLE_LEFT))
-    dest.set_pixel(0, 0, source.get_pixel(src_x, src_y));
+    dest.set_pixel(dest_x, dest_y, source.get_pixel(src_x, src_y));
   // Top right.
   if ((image_flags & IF_TILEABLE_TOP) && (image_flags & IF_TILEABLE_RIGHT))
-    dest.set_pixel(dest.width() - 1, 0, source.get_pixel(src_x + src_width - 1, src_y));
+    dest.set_pixel(right, dest_y, source.get_pixel(src_x + src_width - 1, src_y));
   // Bottom left.
   if ((image_flags & IF_TILEABLE_BOTTOM) && (image_flags & IF_TILEABLE_LEFT))
-    dest.set_pixel(0, dest.height() - 1, source.get_pixel(src_x, src_y + src_height - 1));
+    dest.set_pixel(dest_x, bottom, source.get_pixel(src_x, src_y + src_height - 1));
   // Bottom right.
   if ((image_flags & IF_TILEABLE_BOTTOM) && (image_flags & IF_TILEABLE_RIGHT))
-    dest.set_pixel(dest.width() - 1, dest.height() - 1,
-      source.get_pixel(src_x + src_width - 1, src_y + src_height - 1));
+    dest.set_pixel(right, bottom, source.get_pixel(src_x + src_width - 1, src_y + src_height - 1));
   // Now put the final image into the prepared borders.
-  dest.insert(source, 1, 1, src_x, src_y, src_width, src_height);
+  dest.insert(source, dest_x + 1, dest_y + 1, src_x, src_y, src_width, src_height);
 }
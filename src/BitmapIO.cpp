@@ -5,8 +5,20 @@
 #include "IO.hpp"
 #include "Platform.hpp"
 #include "Utility.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
 #include <cstring>
+#include <functional>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
+#include <vector>
+#ifdef GOSU_IS_WIN
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 #include "debugwriter.h"
 #define STB_IMAGE_IMPLEMENTATION
 #define STBI_NO_STDIO
@@ -49,66 +61,492 @@ namespace
     return reader->position() == reader->resource().size();
   }
 
-  bool is_bmp(Gosu::Reader reader)
+  // Returns the unread rest of the resource if it is all in memory, e.g. a memory-mapped file.
+  const char* contiguous_data(const Gosu::Reader& reader)
+  {
+    const Gosu::Resource& resource = reader.resource();
+    const void* data = nullptr;
+    if (const Gosu::File* file = dynamic_cast<const Gosu::File*>(&resource))
+      data = file->data();
+    else if (const Gosu::Buffer* buffer = dynamic_cast<const Gosu::Buffer*>(&resource))
+      data = buffer->size() > 0 ? buffer->data() : nullptr;
+    if (data == nullptr || reader.position() >= resource.size()) return nullptr;
+    return static_cast<const char*>(data) + reader.position();
+  }
+
+  bool starts_with(Gosu::Reader reader, const char* magic, size_t length)
   {
     size_t remaining = reader.resource().size() - reader.position();
-    if (remaining < 2) return false;
-    char magic_bytes[2];
-    reader.read(magic_bytes, sizeof magic_bytes);
-    return magic_bytes[0] == 'B' && magic_bytes[1] == 'M';
+    if (remaining < length) return false;
+    char magic_bytes[16];
+    reader.read(magic_bytes, length);
+    return memcmp(magic_bytes, magic, length) == 0;
+  }
+
+  bool is_bmp(Gosu::Reader reader)
+  {
+    return starts_with(reader, "BM", 2);
+  }
+
+  // Raw images are a 16-byte header (magic bytes, then width and height as little-endian 32-bit
+  // integers) followed by the pixels, row by row, four bytes each in RGBA order.
+  const char RAW_MAGIC[8] = { 'G', 'o', 's', 'u', 'R', 'G', 'B', 'A' };
+  const size_t RAW_HEADER_SIZE = 16;
+
+  void write_raw_header(char* header, unsigned width, unsigned height)
+  {
+    memcpy(header, RAW_MAGIC, sizeof RAW_MAGIC);
+    for (int i = 0; i < 4; ++i) {
+      header[8 + i]  = static_cast<char>(width  >> (i * 8));
+      header[12 + i] = static_cast<char>(height >> (i * 8));
+    }
+  }
+
+  // Returns the pixels of a raw image in memory, or nullptr if it is not one.
+  const Gosu::Color* read_raw_header(const char* data, size_t size, unsigned& width,
+                                     unsigned& height)
+  {
+    if (size < RAW_HEADER_SIZE || memcmp(data, RAW_MAGIC, sizeof RAW_MAGIC) != 0) return nullptr;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    width = height = 0;
+    for (int i = 0; i < 4; ++i) {
+      width  |= unsigned(bytes[8 + i])  << (i * 8);
+      height |= unsigned(bytes[12 + i]) << (i * 8);
+    }
+    if ((size - RAW_HEADER_SIZE) / sizeof(Gosu::Color) != uint64_t(width) * height)
+      return nullptr;
+    return reinterpret_cast<const Gosu::Color*>(data + RAW_HEADER_SIZE);
+  }
+
+  vector<char> encode_raw(const Gosu::BitmapView& view)
+  {
+    size_t row_size = view.width() * sizeof(Gosu::Color);
+    vector<char> result(RAW_HEADER_SIZE + row_size * view.height());
+    write_raw_header(result.data(), view.width(), view.height());
+    for (unsigned y = 0; y < view.height(); ++y)
+      memcpy(result.data() + RAW_HEADER_SIZE + y * row_size, view.row(y), row_size);
+    return result;
+  }
+
+  // QOI, the "Quite OK Image Format" (https://qoiformat.org/): lossless like PNG, but encoded
+  // and decoded in a single pass without any entropy coding. As everywhere in this file, colors
+  // are handled as four bytes in RGBA order, just like stb_image returns them.
+  const char QOI_MAGIC[4] = { 'q', 'o', 'i', 'f' };
+  const size_t QOI_HEADER_SIZE = 14;
+  const unsigned char QOI_END[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+  const unsigned char QOI_OP_INDEX = 0x00, QOI_OP_DIFF = 0x40, QOI_OP_LUMA = 0x80,
+                      QOI_OP_RUN = 0xc0, QOI_OP_RGB = 0xfe, QOI_OP_RGBA = 0xff;
+  // Protects against headers that would make us allocate absurd amounts of memory.
+  const uint64_t QOI_MAX_PIXELS = 400000000;
+
+  struct QoiPixel
+  {
+    unsigned char r, g, b, a;
+
+    bool operator==(const QoiPixel& other) const
+    {
+      return r == other.r && g == other.g && b == other.b && a == other.a;
+    }
+
+    unsigned hash() const
+    {
+      return (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+    }
+  };
+
+  vector<char> encode_qoi(const Gosu::BitmapView& view)
+  {
+    vector<char> result;
+    // Worst case: every pixel needs a QOI_OP_RGBA chunk.
+    result.reserve(QOI_HEADER_SIZE + view.width() * view.height() * 5 + sizeof QOI_END);
+    result.insert(result.end(), QOI_MAGIC, QOI_MAGIC + sizeof QOI_MAGIC);
+    for (unsigned value : { view.width(), view.height() }) {
+      for (int shift = 24; shift >= 0; shift -= 8)
+        result.push_back(static_cast<char>(value >> shift));
+    }
+    result.push_back(4); // Channels.
+    result.push_back(0); // sRGB with linear alpha.
+
+    QoiPixel index[64] = {};
+    QoiPixel previous = { 0, 0, 0, 255 };
+    unsigned run = 0;
+    for (unsigned y = 0; y < view.height(); ++y) {
+      const QoiPixel* row = reinterpret_cast<const QoiPixel*>(view.row(y));
+      for (unsigned x = 0; x < view.width(); ++x) {
+        QoiPixel pixel = row[x];
+        if (pixel == previous) {
+          if (++run == 62) {
+            result.push_back(static_cast<char>(QOI_OP_RUN | (run - 1)));
+            run = 0;
+          }
+          continue;
+        }
+        if (run > 0) {
+          result.push_back(static_cast<char>(QOI_OP_RUN | (run - 1)));
+          run = 0;
+        }
+        unsigned hash = pixel.hash();
+        if (index[hash] == pixel) {
+          result.push_back(static_cast<char>(QOI_OP_INDEX | hash));
+        }
+        else if (pixel.a != previous.a) {
+          index[hash] = pixel;
+          result.push_back(static_cast<char>(QOI_OP_RGBA));
+          result.insert(result.end(), { char(pixel.r), char(pixel.g), char(pixel.b),
+                                        char(pixel.a) });
+        }
+        else {
+          index[hash] = pixel;
+          signed char dr = pixel.r - previous.r, dg = pixel.g - previous.g,
+                      db = pixel.b - previous.b;
+          signed char dr_dg = dr - dg, db_dg = db - dg;
+          if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+            result.push_back(static_cast<char>(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 |
+                                               (db + 2)));
+          }
+          else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 &&
+                   db_dg >= -8 && db_dg <= 7) {
+            result.push_back(static_cast<char>(QOI_OP_LUMA | (dg + 32)));
+            result.push_back(static_cast<char>((dr_dg + 8) << 4 | (db_dg + 8)));
+          }
+          else {
+            result.push_back(static_cast<char>(QOI_OP_RGB));
+            result.insert(result.end(), { char(pixel.r), char(pixel.g), char(pixel.b) });
+          }
+        }
+        previous = pixel;
+      }
+    }
+    if (run > 0) result.push_back(static_cast<char>(QOI_OP_RUN | (run - 1)));
+    result.insert(result.end(), QOI_END, QOI_END + sizeof QOI_END);
+    return result;
+  }
+
+  bool read_qoi_header(const char* data, size_t size, unsigned& width, unsigned& height)
+  {
+    if (size < QOI_HEADER_SIZE || memcmp(data, QOI_MAGIC, sizeof QOI_MAGIC) != 0) return false;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    width  = unsigned(bytes[4]) << 24 | unsigned(bytes[5]) << 16 | unsigned(bytes[6]) << 8 |
+             bytes[7];
+    height = unsigned(bytes[8]) << 24 | unsigned(bytes[9]) << 16 | unsigned(bytes[10]) << 8 |
+             bytes[11];
+    return true;
+  }
+
+  void decode_qoi(const char* data, size_t size, Gosu::Bitmap& bitmap)
+  {
+    unsigned width, height;
+    if (!read_qoi_header(data, size, width, height) || size < QOI_HEADER_SIZE + sizeof QOI_END)
+      throw runtime_error("Cannot load image: invalid QOI header");
+    if (width == 0 || height == 0 || uint64_t(width) * height > QOI_MAX_PIXELS)
+      throw runtime_error("Cannot load image: invalid QOI image size");
+
+    Gosu::Bitmap result(width, height);
+    QoiPixel* out = reinterpret_cast<QoiPixel*>(result.data());
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    // Chunks never extend into the end marker, which leaves room for reading a whole
+    // QOI_OP_RGBA chunk without checking the size each time.
+    size_t pos = QOI_HEADER_SIZE, chunks_end = size - sizeof QOI_END;
+    QoiPixel index[64] = {};
+    QoiPixel pixel = { 0, 0, 0, 255 };
+    unsigned run = 0;
+    for (size_t i = 0, count = size_t(width) * height; i < count; ++i) {
+      if (run > 0) {
+        --run;
+      }
+      else if (pos < chunks_end) {
+        unsigned char op = bytes[pos++];
+        if (op == QOI_OP_RGB) {
+          pixel.r = bytes[pos++];
+          pixel.g = bytes[pos++];
+          pixel.b = bytes[pos++];
+        }
+        else if (op == QOI_OP_RGBA) {
+          pixel.r = bytes[pos++];
+          pixel.g = bytes[pos++];
+          pixel.b = bytes[pos++];
+          pixel.a = bytes[pos++];
+        }
+        else if ((op & 0xc0) == QOI_OP_INDEX) {
+          pixel = index[op];
+        }
+        else if ((op & 0xc0) == QOI_OP_DIFF) {
+          pixel.r += ((op >> 4) & 0x03) - 2;
+          pixel.g += ((op >> 2) & 0x03) - 2;
+          pixel.b += (op & 0x03) - 2;
+        }
+        else if ((op & 0xc0) == QOI_OP_LUMA) {
+          unsigned char second = bytes[pos++];
+          int dg = (op & 0x3f) - 32;
+          pixel.r += dg - 8 + ((second >> 4) & 0x0f);
+          pixel.g += dg;
+          pixel.b += dg - 8 + (second & 0x0f);
+        }
+        else {
+          run = op & 0x3f;
+        }
+        index[pixel.hash()] = pixel;
+      }
+      // Truncated files repeat the last pixel, like the reference decoder does.
+      out[i] = pixel;
+    }
+    result.swap(bitmap);
+  }
+
+  void decode_raw(const char* data, size_t size, Gosu::Bitmap& bitmap)
+  {
+    unsigned width, height;
+    const Gosu::Color* pixels = read_raw_header(data, size, width, height);
+    if (pixels == nullptr) throw runtime_error("Cannot load image: invalid raw RGBA file");
+    Gosu::Bitmap(Gosu::BitmapView(pixels, width, height, width)).swap(bitmap);
   }
+
+  // Does for the formats decoded here what stb_image's flip flags do for the others.
+  void flip(Gosu::Bitmap& bitmap, bool flip_h, bool flip_y)
+  {
+    unsigned width = bitmap.width(), height = bitmap.height();
+    Gosu::Color* pixels = bitmap.data();
+    if (flip_h) {
+      for (unsigned y = 0; y < height; ++y)
+        reverse(pixels + y * width, pixels + (y + 1) * width);
+    }
+    if (flip_y) {
+      for (unsigned y = 0; y < height / 2; ++y)
+        swap_ranges(pixels + y * width, pixels + (y + 1) * width,
+                    pixels + (height - 1 - y) * width);
+    }
+  }
+
+  // Bump this whenever decoding changes, so that stale cache entries are not used.
+  // 2: QOI and raw images are flipped, too.
+  const unsigned char CACHE_VERSION = 2;
+
+  mutex cache_mutex;
+  string cache_directory;
+  // Set by enable_flip_h/enable_flip_y for the images that the calling thread loads. stb_image
+  // does not report these, but they change what a file decodes to.
+  thread_local bool flip_h_on_load = false, flip_y_on_load = false;
+
+  // FNV-1a over 64-bit words, which is plenty to tell image files apart, and fast enough to be
+  // negligible next to decoding.
+  uint64_t fnv1a(const char* data, size_t size, uint64_t hash = 14695981039346656037ull)
+  {
+    const uint64_t PRIME = 1099511628211ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+      uint64_t word;
+      memcpy(&word, data + i, sizeof word);
+      hash = (hash ^ word) * PRIME;
+    }
+    for (; i < size; ++i)
+      hash = (hash ^ static_cast<unsigned char>(data[i])) * PRIME;
+    return hash;
+  }
+
+  // Returns where the decoded contents of file are cached, or an empty string if caching is
+  // off or the file could not be mapped into memory.
+  string cache_filename(const Gosu::File& file, bool flip_h, bool flip_y)
+  {
+    string directory;
+    const char variant[3] = { char(CACHE_VERSION), char(flip_h), char(flip_y) };
+    {
+      lock_guard<mutex> lock(cache_mutex);
+      if (cache_directory.empty()) return string();
+      directory = cache_directory;
+    }
+    const char* data = static_cast<const char*>(file.data());
+    if (data == nullptr) return string();
+    uint64_t hash = fnv1a(variant, sizeof variant, fnv1a(data, file.size()));
+    char name[32];
+    snprintf(name, sizeof name, "%016llx.rgba", static_cast<unsigned long long>(hash));
+    return directory + "/" + name;
+  }
+
+  bool load_cached_image(Gosu::Bitmap& bitmap, const string& filename)
+  {
+    try {
+      Gosu::File file(filename);
+      const char* data = static_cast<const char*>(file.data());
+      unsigned width, height;
+      const Gosu::Color* pixels =
+        data ? read_raw_header(data, file.size(), width, height) : nullptr;
+      if (pixels == nullptr) return false;
+      Gosu::Bitmap(Gosu::BitmapView(pixels, width, height, width)).swap(bitmap);
+      return true;
+    }
+    catch (const runtime_error&) {
+      return false;
+    }
+  }
+
+  unsigned long process_id()
+  {
+#ifdef GOSU_IS_WIN
+    return _getpid();
+#else
+    return getpid();
+#endif
+  }
+
+  void save_cached_image(const Gosu::Bitmap& bitmap, const string& filename)
+  {
+    if (bitmap.pixels.empty()) return;
+    // Write under a temporary name first, so that other threads and processes never map a
+    // partially written file. Thread ids are only unique within a process.
+    string temp_filename = filename + "." + to_string(process_id()) + "." +
+      to_string(hash<thread::id>()(this_thread::get_id())) + ".tmp";
+    try {
+      {
+        Gosu::File file(temp_filename, Gosu::FM_REPLACE);
+        char header[RAW_HEADER_SIZE];
+        write_raw_header(header, bitmap.width(), bitmap.height());
+        file.write(0, sizeof header, header);
+        file.write(sizeof header, bitmap.pixels.size() * sizeof(Gosu::Color), bitmap.data());
+      }
+      if (rename(temp_filename.c_str(), filename.c_str()) != 0) remove(temp_filename.c_str());
+    }
+    catch (const runtime_error&) {
+      // The cache is only an optimization; the image has been loaded either way.
+      remove(temp_filename.c_str());
+    }
+  }
+}
+
+void Gosu::set_image_cache_directory(const string& directory)
+{
+  lock_guard<mutex> lock(cache_mutex);
+  cache_directory = directory;
 }
 
 void Gosu::enable_flip_h(bool flip_h)
 {
-  stbi_kyon_set_flip_horizontally_on_load(flip_h);
+  flip_h_on_load = flip_h;
 }
 
 void Gosu::enable_flip_y(bool flip_y)
 {
-  stbi_set_flip_vertically_on_load(flip_y);
+  flip_y_on_load = flip_y;
 }
 
 void Gosu::enable_flip_h_y(bool flip_h, bool flip_y)
 {
-  stbi_kyon_set_flip_horizontally_on_load(flip_h);
-  stbi_set_flip_vertically_on_load(flip_y);
+  enable_flip_h(flip_h);
+  enable_flip_y(flip_y);
 }
 
 void Gosu::load_image_inverse_color(Gosu::Bitmap& bitmap, const string& filename)
 {
   load_image_file(bitmap, filename);
-  int w = bitmap.width(), h = bitmap.height();
-  for (int x = 0; x < w; x++)
-    for (int y = 0; y < h; y++)
-      bitmap.invert_pixel(x, y);
+  invert_colors(bitmap);
+}
+
+bool Gosu::flip_h_enabled()
+{
+  return flip_h_on_load;
+}
+
+bool Gosu::flip_y_enabled()
+{
+  return flip_y_on_load;
 }
 
 void Gosu::load_image_file(Gosu::Bitmap& bitmap, const string& filename)
 {
-  Buffer buffer;
-  load_file(buffer, filename);
-  load_image_file(bitmap, buffer.front_reader());
+  bool flip_h = flip_h_on_load;
+  // One image only, see enable_flip_h.
+  flip_h_on_load = false;
+  load_image_file(bitmap, filename, flip_h, flip_y_on_load);
+}
+
+void Gosu::load_image_file(Gosu::Bitmap& bitmap, const string& filename, bool flip_h, bool flip_y)
+{
+  File file(filename);
+  string cached = cache_filename(file, flip_h, flip_y);
+  if (!cached.empty() && load_cached_image(bitmap, cached)) return;
+  load_image_file(bitmap, file.front_reader(), flip_h, flip_y);
+  if (!cached.empty()) save_cached_image(bitmap, cached);
 }
 
 void Gosu::load_image_file(Gosu::Bitmap& bitmap, Reader input)
 {
+  bool flip_h = flip_h_on_load;
+  // One image only, see enable_flip_h.
+  flip_h_on_load = false;
+  load_image_file(bitmap, input, flip_h, flip_y_on_load);
+}
+
+void Gosu::load_image_file(Gosu::Bitmap& bitmap, Reader input, bool flip_h, bool flip_y)
+{
+  // QOI and raw images are decoded here, everything else by stb_image.
+  bool is_qoi = starts_with(input, QOI_MAGIC, sizeof QOI_MAGIC);
+  if (is_qoi || starts_with(input, RAW_MAGIC, sizeof RAW_MAGIC)) {
+    size_t size = input.resource().size() - input.position();
+    const char* data = contiguous_data(input);
+    vector<char> copy;
+    if (data == nullptr) {
+      copy.resize(size);
+      input.read(copy.data(), size);
+      data = copy.data();
+    }
+    if (is_qoi) decode_qoi(data, size, bitmap);
+    else decode_raw(data, size, bitmap);
+    flip(bitmap, flip_h, flip_y);
+    return;
+  }
+
   bool needs_color_key = is_bmp(input);
-  stbi_io_callbacks callbacks;
-  callbacks.read = read_callback;
-  callbacks.skip = skip_callback;
-  callbacks.eof = eof_callback;
+  // stb_image keeps these per thread, and forgets about horizontal flipping after each image,
+  // so set both every time.
+  stbi_kyon_set_flip_horizontally_on_load(flip_h);
+  stbi_set_flip_vertically_on_load(flip_y);
   int x, y, n;
-  stbi_uc* bytes = stbi_load_from_callbacks(&callbacks, &input, &x, &y, &n, STBI_rgb_alpha);
-  if (bytes == nullptr) {
-// TODO - stbi_failure_reason is not thread safe. It should be wrapped in a mutex.
-    throw runtime_error("Cannot load image: " + string(stbi_failure_reason()));
+  stbi_uc* bytes;
+  if (const char* data = contiguous_data(input)) {
+    // Decode straight from the mapped file or buffer instead of copying it chunk by chunk.
+    size_t size = input.resource().size() - input.position();
+    bytes = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(data),
+                                  static_cast<int>(size), &x, &y, &n, STBI_rgb_alpha);
+  }
+  else {
+    stbi_io_callbacks callbacks;
+    callbacks.read = read_callback;
+    callbacks.skip = skip_callback;
+    callbacks.eof = eof_callback;
+    bytes = stbi_load_from_callbacks(&callbacks, &input, &x, &y, &n, STBI_rgb_alpha);
   }
-  bitmap.resize(x, y);
-  memcpy(bitmap.data(), bytes, x * y * sizeof(Gosu::Color));
+  // The failure reason is per thread, too.
+  if (bytes == nullptr) throw runtime_error("Cannot load image: " + string(stbi_failure_reason()));
+  // Copy the pixels once, without clearing or preserving the previous contents of bitmap.
+  Bitmap(BitmapView(reinterpret_cast<const Color*>(bytes), x, y, x)).swap(bitmap);
   stbi_image_free(bytes);
   if (needs_color_key) apply_color_key(bitmap, Gosu::Color::FUCHSIA);
 }
+
+void Gosu::load_image_size(const string& filename, unsigned& width, unsigned& height)
+{
+  File file(filename);
+  Reader input = file.front_reader();
+  char header[RAW_HEADER_SIZE] = {};
+  file.read(0, min(file.size(), sizeof header), header);
+  if (read_qoi_header(header, sizeof header, width, height)) return;
+  // Only the header is passed in, but the size of the whole file is checked.
+  if (read_raw_header(header, file.size(), width, height)) return;
+  int x, y, n, ok;
+  if (const char* data = contiguous_data(input)) {
+    ok = stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(data),
+                               static_cast<int>(file.size()), &x, &y, &n);
+  }
+  else {
+    stbi_io_callbacks callbacks;
+    callbacks.read = read_callback;
+    callbacks.skip = skip_callback;
+    callbacks.eof = eof_callback;
+    ok = stbi_info_from_callbacks(&callbacks, &input, &x, &y, &n);
+  }
+  if (!ok) throw runtime_error("Cannot load image: " + string(stbi_failure_reason()));
+  width = x;
+  height = y;
+}
 // Disable comma warnings in stb headers.
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -122,17 +560,37 @@ void Gosu::load_image_file(Gosu::Bitmap& bitmap, Reader input)
 #pragma GCC diagnostic pop
 #endif
 
-void Gosu::save_image_file(const Gosu::Bitmap& bitmap, const string& filename)
+// Only the PNG writer understands row strides; the other formats need one block of pixels.
+static const Gosu::Color* contiguous_pixels(const Gosu::BitmapView& view, Gosu::Bitmap& copy)
+{
+  if (view.contiguous()) return view.data();
+  Gosu::Bitmap(view).swap(copy);
+  return copy.data();
+}
+
+void Gosu::save_image_file(const Gosu::BitmapView& bitmap, const string& filename)
 {
+  if (has_extension(filename, "qoi") || has_extension(filename, "rgba")) {
+    vector<char> encoded =
+      has_extension(filename, "qoi") ? encode_qoi(bitmap) : encode_raw(bitmap);
+    File file(filename, FM_REPLACE);
+    file.write(0, encoded.size(), encoded.data());
+    return;
+  }
+  Bitmap copy;
   int ok;
   if (has_extension(filename, "bmp"))
-    ok = stbi_write_bmp(filename.c_str(), bitmap.width(), bitmap.height(), 4, bitmap.data());
+    ok = stbi_write_bmp(filename.c_str(), bitmap.width(), bitmap.height(), 4,
+      contiguous_pixels(bitmap, copy));
   else if (has_extension(filename, "tga"))
-    ok = stbi_write_tga(filename.c_str(), bitmap.width(), bitmap.height(), 4, bitmap.data());
+    ok = stbi_write_tga(filename.c_str(), bitmap.width(), bitmap.height(), 4,
+      contiguous_pixels(bitmap, copy));
   else if (has_extension(filename, "jpg") || has_extension(filename, "jpeg"))
-    ok = stbi_write_jpg(filename.c_str(), bitmap.width(), bitmap.height(), 4, bitmap.data(), 95);
+    ok = stbi_write_jpg(filename.c_str(), bitmap.width(), bitmap.height(), 4,
+      contiguous_pixels(bitmap, copy), 95);
   else
-    ok = stbi_write_png(filename.c_str(), bitmap.width(), bitmap.height(), 4, bitmap.data(), 0);
+    ok = stbi_write_png(filename.c_str(), bitmap.width(), bitmap.height(), 4, bitmap.data(),
+      bitmap.stride() * sizeof(Color));
   if (ok == 0) throw runtime_error("Could not save image data to file: " + filename);
 }
 
@@ -141,23 +599,30 @@ static void stbi_write_to_writer(void* context, void* data, int size)
   reinterpret_cast<Gosu::Writer*>(context)->write(data, size);
 }
 
-void Gosu::save_image_file(const Gosu::Bitmap& bitmap, Gosu::Writer writer,
+void Gosu::save_image_file(const Gosu::BitmapView& bitmap, Gosu::Writer writer,
                            const string& format_hint)
 {
+  if (has_extension(format_hint, "qoi") || has_extension(format_hint, "rgba")) {
+    vector<char> encoded =
+      has_extension(format_hint, "qoi") ? encode_qoi(bitmap) : encode_raw(bitmap);
+    writer.write(encoded.data(), encoded.size());
+    return;
+  }
+  Bitmap copy;
   int ok;
   if (has_extension(format_hint, "bmp")) {
     ok = stbi_write_bmp_to_func(stbi_write_to_writer, &writer, bitmap.width(), bitmap.height(),
-      4, bitmap.data());
+      4, contiguous_pixels(bitmap, copy));
   } else if (has_extension(format_hint, "tga")) {
     stbi_write_tga_with_rle = 0;
     ok = stbi_write_tga_to_func(stbi_write_to_writer, &writer, bitmap.width(), bitmap.height(),
-      4, bitmap.data());
+      4, contiguous_pixels(bitmap, copy));
   } else if (has_extension(format_hint, "jpg") || has_extension(format_hint, "jpeg")) {
     ok = stbi_write_jpg_to_func(stbi_write_to_writer, &writer, bitmap.width(), bitmap.height(),
-      4, bitmap.data(), 95);
+      4, contiguous_pixels(bitmap, copy), 95);
   } else {
     ok = stbi_write_png_to_func(stbi_write_to_writer, &writer, bitmap.width(), bitmap.height(),
-      4, bitmap.data(), 0);
+      4, bitmap.data(), bitmap.stride() * sizeof(Color));
   }
   if (ok > 0) return;
   throw runtime_error("Could not save image data to memory (format hint = '" + format_hint + "'");
@@ -165,14 +630,5 @@ void Gosu::save_image_file(const Gosu::Bitmap& bitmap, Gosu::Writer writer,
 
 void Gosu::save_image_file(const string& filename, unsigned w, unsigned h, unsigned char* data)
 {
-  int ok;
-  if (has_extension(filename, "bmp"))
-    ok = stbi_write_bmp(filename.c_str(), w, h, 4, data);
-  else if (has_extension(filename, "tga"))
-    ok = stbi_write_tga(filename.c_str(), w, h, 4, data);
-  else if (has_extension(filename, "jpg") || has_extension(filename, "jpeg"))
-    ok = stbi_write_jpg(filename.c_str(), w, h, 4, data, 95);
-  else
-    ok = stbi_write_png(filename.c_str(), w, h, 4, data, 0);
-  if (ok == 0) throw runtime_error("Could not save image data to file: " + filename);
+  save_image_file(BitmapView(reinterpret_cast<const Color*>(data), w, h, w), filename);
 }
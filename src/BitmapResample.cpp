@@ -0,0 +1,181 @@
+#include "Bitmap.hpp"
+#include "Math.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+using namespace std;
+
+namespace Gosu
+{
+  namespace
+  {
+    // A pixel with premultiplied alpha, so that transparent pixels do not bleed their color into
+    // their neighbors, and without clamping, because Lanczos overshoots.
+    struct alignas(16) FloatPixel
+    {
+      float c[4];
+    };
+
+    inline void accumulate(FloatPixel& sum, const FloatPixel& s, float weight)
+    {
+#ifdef __SSE2__
+      _mm_store_ps(sum.c, _mm_add_ps(_mm_load_ps(sum.c),
+                                     _mm_mul_ps(_mm_load_ps(s.c), _mm_set1_ps(weight))));
+#else
+      for (int i = 0; i < 4; ++i) sum.c[i] += s.c[i] * weight;
+#endif
+    }
+
+    double sinc(double x)
+    {
+      if (x == 0) return 1;
+      x *= M_PI;
+      return sin(x) / x;
+    }
+
+    double filter_support(ResampleFilter filter)
+    {
+      switch (filter) {
+        case RF_BOX:      return 0.5;
+        case RF_BILINEAR: return 1;
+        default:          return 3;
+      }
+    }
+
+    double filter_weight(ResampleFilter filter, double x)
+    {
+      x = abs(x);
+      switch (filter) {
+        case RF_BOX:      return x <= 0.5 ? 1 : 0;
+        case RF_BILINEAR: return max(0.0, 1 - x);
+        default:          return x < 3 ? sinc(x) * sinc(x / 3) : 0;
+      }
+    }
+
+    // For each target pixel along one axis, the first source pixel that contributes to it and
+    // the weights of all contributing source pixels.
+    struct Contributions
+    {
+      vector<unsigned> first, count;
+      vector<float> weights;
+      unsigned stride;
+    };
+
+    Contributions contributions(unsigned src_size, unsigned dest_size, ResampleFilter filter)
+    {
+      double scale = double(dest_size) / src_size;
+      // When shrinking, the filter is stretched so that every source pixel is taken into
+      // account.
+      double filter_scale = max(1.0, 1 / scale);
+      double support = filter_support(filter) * filter_scale;
+
+      Contributions result;
+      result.stride = static_cast<unsigned>(ceil(support)) * 2 + 1;
+      result.first.resize(dest_size);
+      result.count.resize(dest_size);
+      result.weights.resize(dest_size * result.stride);
+      for (unsigned i = 0; i < dest_size; ++i) {
+        double center = (i + 0.5) / scale;
+        int left = max(0, static_cast<int>(floor(center - support)));
+        int right = min<int>(src_size - 1, static_cast<int>(ceil(center + support)));
+        right = min(right, left + static_cast<int>(result.stride) - 1);
+        float* weights = &result.weights[i * result.stride];
+        double total = 0;
+        for (int j = left; j <= right; ++j) {
+          weights[j - left] = filter_weight(filter, (j + 0.5 - center) / filter_scale);
+          total += weights[j - left];
+        }
+        if (total == 0) {
+          // Only possible for a box filter that falls between two pixels.
+          left = right = min<int>(src_size - 1, static_cast<int>(center));
+          weights[0] = 1;
+          total = 1;
+        }
+        for (int j = left; j <= right; ++j) weights[j - left] /= total;
+        result.first[i] = left;
+        result.count[i] = right - left + 1;
+      }
+      return result;
+    }
+
+    // Bands of at least this many rows are worth handing to another thread.
+    const unsigned MIN_ROWS_PER_THREAD = 16;
+  }
+}
+
+Gosu::Bitmap Gosu::resample(const Bitmap& source, unsigned width, unsigned height,
+                            ResampleFilter filter)
+{
+  if (width == 0 || height == 0 || source.width() == 0 || source.height() == 0)
+    throw invalid_argument("Cannot resample from or to an empty bitmap");
+
+  // The filter is separable: First scale every row horizontally into an intermediate buffer,
+  // then scale its columns vertically. Both passes walk memory row by row.
+  Contributions horizontal = contributions(source.width(), width, filter);
+  Contributions vertical = contributions(source.height(), height, filter);
+  vector<FloatPixel> intermediate(source.height() * width);
+
+  parallel_for(source.height(), MIN_ROWS_PER_THREAD, [&](unsigned begin, unsigned end) {
+    vector<FloatPixel> row(source.width());
+    for (unsigned y = begin; y < end; ++y) {
+      const Color* src = source.data() + y * source.width();
+      for (unsigned x = 0; x < source.width(); ++x) {
+        float alpha = src[x].alpha() / 255.f;
+        row[x] = FloatPixel{{src[x].red() * alpha, src[x].green() * alpha,
+                         src[x].blue() * alpha, float(src[x].alpha())}};
+      }
+      FloatPixel* out = &intermediate[y * width];
+      for (unsigned x = 0; x < width; ++x) {
+        FloatPixel sum = {};
+        const float* weights = &horizontal.weights[x * horizontal.stride];
+        for (unsigned i = 0; i < horizontal.count[x]; ++i)
+          accumulate(sum, row[horizontal.first[x] + i], weights[i]);
+        out[x] = sum;
+      }
+    }
+  });
+
+  Bitmap result(width, height);
+  parallel_for(height, MIN_ROWS_PER_THREAD, [&](unsigned begin, unsigned end) {
+    vector<FloatPixel> sums(width);
+    for (unsigned y = begin; y < end; ++y) {
+      fill(sums.begin(), sums.end(), FloatPixel{});
+      const float* weights = &vertical.weights[y * vertical.stride];
+      for (unsigned i = 0; i < vertical.count[y]; ++i) {
+        const FloatPixel* in = &intermediate[(vertical.first[y] + i) * width];
+        for (unsigned x = 0; x < width; ++x) accumulate(sums[x], in[x], weights[i]);
+      }
+      Color* out = result.data() + y * width;
+      for (unsigned x = 0; x < width; ++x) {
+        const float* c = sums[x].c;
+        float alpha = min(max(c[3], 0.f), 255.f);
+        if (alpha < 0.5f) {
+          out[x] = Color::NONE;
+          continue;
+        }
+        float unpremultiply = 255 / alpha;
+        auto channel = [&](float value) {
+          return static_cast<Color::Channel>(min(max(value * unpremultiply, 0.f), 255.f) + 0.5f);
+        };
+        out[x] = Color(static_cast<Color::Channel>(alpha + 0.5f), channel(c[0]), channel(c[1]),
+                       channel(c[2]));
+      }
+    }
+  });
+  return result;
+}
+
+void Gosu::shrink_to_fit(Bitmap& bitmap, unsigned max_width, unsigned max_height,
+                         ResampleFilter filter)
+{
+  if (bitmap.width() <= max_width && bitmap.height() <= max_height) return;
+  double scale = min(double(max_width) / bitmap.width(), double(max_height) / bitmap.height());
+  unsigned width = max(1u, static_cast<unsigned>(round(bitmap.width() * scale)));
+  unsigned height = max(1u, static_cast<unsigned>(round(bitmap.height() * scale)));
+  resample(bitmap, width, height, filter).swap(bitmap);
+}
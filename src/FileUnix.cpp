@@ -48,7 +48,7 @@ Gosu::File::File(const string& filename, FileMode mode)
   pimpl->fd = open(filename.c_str(), flags, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH);
   if (pimpl->fd < 0) throw runtime_error("Cannot open file " + filename);
   if (mode == FM_READ && size() > 0)
-    pimpl->mapping = mmap(nullptr, size(), PROT_READ, 0, pimpl->fd, 0);
+    pimpl->mapping = mmap(nullptr, size(), PROT_READ, MAP_PRIVATE, pimpl->fd, 0);
 }
 
 Gosu::File::~File()
@@ -66,6 +66,11 @@ void Gosu::File::resize(size_t new_size)
   ftruncate(pimpl->fd, new_size);
 }
 
+const void* Gosu::File::data() const
+{
+  return pimpl->mapping != MAP_FAILED ? pimpl->mapping : nullptr;
+}
+
 void Gosu::File::read(size_t offset, size_t length, void* dest_buffer) const
 {
   // TODO: Bounds checks?
@@ -12,9 +12,17 @@ using namespace std;
 struct Gosu::File::Impl
 {
     HANDLE handle = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+    const void* view = nullptr;
 
     ~Impl()
     {
+        if (view) {
+            UnmapViewOfFile(view);
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+        }
         if (handle != INVALID_HANDLE_VALUE) {
             CloseHandle(handle);
         }
@@ -48,6 +56,12 @@ Gosu::File::File(const string& filename, FileMode mode)
     if (mode == FM_REPLACE) {
         resize(0);
     }
+    if (mode == FM_READ && size() > 0) {
+        pimpl->mapping = CreateFileMappingW(pimpl->handle, 0, PAGE_READONLY, 0, 0, 0);
+        if (pimpl->mapping) {
+            pimpl->view = MapViewOfFile(pimpl->mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+    }
 }
 
 Gosu::File::~File()
@@ -67,6 +81,11 @@ void Gosu::File::resize(size_t new_size)
     winapi_check(SetEndOfFile(pimpl->handle), "resizing a file");
 }
 
+const void* Gosu::File::data() const
+{
+    return pimpl->view;
+}
+
 void Gosu::File::read(size_t offset, size_t length, void* dest_buffer) const
 {
     if (SetFilePointer(pimpl->handle, offset, 0, FILE_BEGIN) == INVALID_SET_FILE_POINTER) {
@@ -0,0 +1,253 @@
+#include "FrameCapture.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+using namespace std;
+
+struct Gosu::FrameCapture::VideoStream
+{
+  FILE* file;
+  bool y4m;
+  unsigned fps;
+  unsigned width = 0, height = 0;
+
+  VideoStream(const string& filename, unsigned fps)
+  : y4m(filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".y4m") == 0), fps(fps)
+  {
+    file = fopen(filename.c_str(), "wb");
+    if (!file) throw runtime_error("Could not open video file: " + filename);
+  }
+
+  ~VideoStream()
+  {
+    fclose(file);
+  }
+
+  // Expects a frame with the top row first.
+  void write(const Bitmap& frame)
+  {
+    if (width == 0) {
+      width = frame.width();
+      height = frame.height();
+      if (y4m) fprintf(file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, fps);
+    }
+    else if (frame.width() != width || frame.height() != height) {
+      throw runtime_error("Window size changed while recording");
+    }
+
+    if (!y4m) {
+      fwrite(frame.data(), sizeof(Color), frame.pixels.size(), file);
+      return;
+    }
+
+    // BT.601 with studio swing; chroma is averaged over 2x2 blocks.
+    unsigned chroma_w = (width + 1) / 2, chroma_h = (height + 1) / 2;
+    vector<uint8_t> planes(width * height + 2 * chroma_w * chroma_h);
+    uint8_t* luma = planes.data();
+    uint8_t* u = luma + width * height;
+    uint8_t* v = u + chroma_w * chroma_h;
+    for (unsigned i = 0; i < width * height; ++i) {
+      Color c = frame.pixels[i];
+      luma[i] = ((66 * c.red() + 129 * c.green() + 25 * c.blue() + 128) >> 8) + 16;
+    }
+    for (unsigned y = 0; y < chroma_h; ++y) {
+      for (unsigned x = 0; x < chroma_w; ++x) {
+        int r = 0, g = 0, b = 0;
+        for (unsigned dy = 0; dy < 2; ++dy) {
+          for (unsigned dx = 0; dx < 2; ++dx) {
+            Color c = frame.get_pixel(min(2 * x + dx, width - 1), min(2 * y + dy, height - 1));
+            r += c.red();
+            g += c.green();
+            b += c.blue();
+          }
+        }
+        r /= 4, g /= 4, b /= 4;
+        u[y * chroma_w + x] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+        v[y * chroma_w + x] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+      }
+    }
+    fputs("FRAME\n", file);
+    fwrite(planes.data(), 1, planes.size(), file);
+  }
+};
+
+Gosu::FrameCapture::FrameCapture()
+: next_slot_(0), stopping_(false)
+{
+}
+
+Gosu::FrameCapture::~FrameCapture()
+{
+  try {
+    flush();
+  } catch (...) {
+    // Frames that cannot be saved anymore are lost.
+  }
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  job_added_.notify_one();
+  if (encoder_.joinable()) encoder_.join();
+
+#ifndef GOSU_IS_OPENGLES
+  ensure_current_context();
+  for (Slot& slot : slots_) {
+    if (slot.buffer == 0) continue;
+    try {
+      GOSU_LOAD_GL_EXT(glDeleteBuffers, PFNGLDELETEBUFFERSPROC);
+      glDeleteBuffers(1, &slot.buffer);
+    } catch (...) {
+      // The function was loaded when the buffer was created, so this cannot happen.
+    }
+  }
+#endif
+}
+
+void Gosu::FrameCapture::save_next_frame(const string& filename)
+{
+  stills_.push_back(filename);
+}
+
+void Gosu::FrameCapture::start_recording(const string& filename, unsigned fps)
+{
+  if (video_) throw logic_error("Already recording");
+  video_ = make_shared<VideoStream>(filename, fps);
+}
+
+void Gosu::FrameCapture::stop_recording()
+{
+  flush();
+  // The encoder closes the file once it has written the last queued frame.
+  video_.reset();
+  throw_encoder_error();
+}
+
+void Gosu::FrameCapture::capture(unsigned width, unsigned height)
+{
+  throw_encoder_error();
+
+  // The oldest readback has had RING_SIZE frames to complete, so mapping it should not block.
+  Slot& slot = slots_[next_slot_];
+  if (slot.pending) finish(slot);
+  if (stills_.empty() && !video_) {
+    next_slot_ = (next_slot_ + 1) % RING_SIZE;
+    return;
+  }
+
+  ensure_current_context();
+#ifndef GOSU_IS_OPENGLES
+  static bool has_pixel_buffers = SDL_GL_ExtensionSupported("GL_ARB_pixel_buffer_object");
+#else
+  static bool has_pixel_buffers = false;
+#endif
+  if (has_pixel_buffers) {
+#ifndef GOSU_IS_OPENGLES
+    GOSU_LOAD_GL_EXT(glGenBuffers, PFNGLGENBUFFERSPROC);
+    GOSU_LOAD_GL_EXT(glBindBuffer, PFNGLBINDBUFFERPROC);
+    GOSU_LOAD_GL_EXT(glBufferData, PFNGLBUFFERDATAPROC);
+
+    if (slot.buffer == 0) glGenBuffers(1, &slot.buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.width != width || slot.height != height) {
+      glBufferData(GL_PIXEL_PACK_BUFFER, width * height * sizeof(Color), nullptr, GL_STREAM_READ);
+    }
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+#endif
+  }
+  else {
+    slot.frame = Bitmap(width, height);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, slot.frame.data());
+  }
+  slot.width = width;
+  slot.height = height;
+  slot.filenames.swap(stills_);
+  slot.video = video_;
+  slot.pending = true;
+  next_slot_ = (next_slot_ + 1) % RING_SIZE;
+}
+
+void Gosu::FrameCapture::flush()
+{
+  for (unsigned i = 0; i < RING_SIZE; ++i) {
+    Slot& slot = slots_[(next_slot_ + i) % RING_SIZE];
+    if (slot.pending) finish(slot);
+  }
+}
+
+void Gosu::FrameCapture::finish(Slot& slot)
+{
+  Job job;
+  if (slot.buffer != 0) {
+#ifndef GOSU_IS_OPENGLES
+    GOSU_LOAD_GL_EXT(glBindBuffer, PFNGLBINDBUFFERPROC);
+    GOSU_LOAD_GL_EXT(glMapBuffer, PFNGLMAPBUFFERPROC);
+    GOSU_LOAD_GL_EXT(glUnmapBuffer, PFNGLUNMAPBUFFERPROC);
+
+    ensure_current_context();
+    job.frame = Bitmap(slot.width, slot.height);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (const void* pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY)) {
+      memcpy(job.frame.data(), pixels, job.frame.pixels.size() * sizeof(Color));
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+#endif
+  }
+  else {
+    job.frame = move(slot.frame);
+  }
+  job.filenames.swap(slot.filenames);
+  job.video = move(slot.video);
+  slot.pending = false;
+
+  unique_lock<mutex> lock(mutex_);
+  if (!encoder_.joinable()) encoder_ = thread([this] { encode_jobs(); });
+  job_taken_.wait(lock, [this] { return jobs_.size() < MAX_QUEUED_JOBS; });
+  jobs_.push_back(move(job));
+  lock.unlock();
+  job_added_.notify_one();
+}
+
+void Gosu::FrameCapture::encode_jobs()
+{
+  for (;;) {
+    Job job;
+    {
+      unique_lock<mutex> lock(mutex_);
+      job_added_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+      if (jobs_.empty()) return;
+      job = move(jobs_.front());
+      jobs_.pop_front();
+    }
+    job_taken_.notify_one();
+
+    try {
+      // glReadPixels returns the bottom row first, and the back buffer's alpha channel is
+      // meaningless.
+      Bitmap& frame = job.frame;
+      unsigned w = frame.width(), h = frame.height();
+      for (unsigned y = 0; y < h / 2; ++y) {
+        swap_ranges(frame.data() + y * w, frame.data() + (y + 1) * w,
+                    frame.data() + (h - 1 - y) * w);
+      }
+      for (Color& c : frame.pixels) c.set_alpha(255);
+
+      for (const string& filename : job.filenames) save_image_file(frame, filename);
+      if (job.video) job.video->write(frame);
+    } catch (const exception& e) {
+      lock_guard<mutex> lock(mutex_);
+      if (error_.empty()) error_ = e.what();
+    }
+  }
+}
+
+void Gosu::FrameCapture::throw_encoder_error()
+{
+  lock_guard<mutex> lock(mutex_);
+  if (error_.empty()) return;
+  string message;
+  message.swap(error_);
+  throw runtime_error(message);
+}
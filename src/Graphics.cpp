@@ -8,6 +8,7 @@
 #include "LargeImageData.hpp"
 #include "Macro.hpp"
 #include "OffScreenTarget.hpp"
+#include "TexChunk.hpp"
 #include "Texture.hpp"
 #include "Bitmap.hpp"
 #include "Image.hpp"
@@ -24,6 +25,8 @@ namespace Gosu
   {
     Graphics* current_graphics_pointer = nullptr;
     vector<shared_ptr<Texture>> textures;
+    unsigned max_texture_size = 2048;
+    bool premultiplied = false;
     DrawOpQueueStack queues;
 
     Graphics& current_graphics()
@@ -39,6 +42,37 @@ namespace Gosu
         throw logic_error("There is no rendering queue for this operation");
       return queues.back();
     }
+
+    bool is_transparent_row(const BitmapView& bmp, unsigned x, unsigned y, unsigned width)
+    {
+      for (unsigned i = 0; i < width; ++i)
+        if (bmp.get_pixel(x + i, y).alpha() != 0) return false;
+      return true;
+    }
+
+    bool is_transparent_column(const BitmapView& bmp, unsigned x, unsigned y, unsigned height)
+    {
+      for (unsigned i = 0; i < height; ++i)
+        if (bmp.get_pixel(x, y + i).alpha() != 0) return false;
+      return true;
+    }
+
+    // Shrinks the given rectangle of bmp until no border is fully transparent. At least one
+    // pixel is kept, so that the result can still be put onto a texture.
+    void trim_transparent_borders(const BitmapView& bmp, unsigned& x, unsigned& y,
+      unsigned& width, unsigned& height)
+    {
+      while (height > 1 && is_transparent_row(bmp, x, y, width)) {
+        ++y;
+        --height;
+      }
+      while (height > 1 && is_transparent_row(bmp, x, y + height - 1, width)) --height;
+      while (width > 1 && is_transparent_column(bmp, x, y, height)) {
+        ++x;
+        --width;
+      }
+      while (width > 1 && is_transparent_column(bmp, x + width - 1, y, height)) --width;
+    }
   }
 }
 
@@ -189,6 +223,9 @@ void Gosu::Graphics::frame(const function<void ()>& f)
 
 void Gosu::Graphics::flush()
 {
+  // Upload everything that Image#insert has staged this frame before drawing starts, rather
+  // than in between draw calls.
+  for (auto& texture : textures) texture->flush();
   current_queue().perform_draw_ops_and_code();
   current_queue().clear_queue();
 }
@@ -359,57 +396,178 @@ void Gosu::Graphics::set_physical_resolution(unsigned phys_width, unsigned phys_
   pimpl->update_base_transform();
 }
 
-unique_ptr<Gosu::ImageData> Gosu::Graphics::create_image(const Bitmap& src,
+unsigned Gosu::Graphics::texture_size()
+{
+  static GLint gl_max_size = -1;
+  if (gl_max_size < 0) {
+    ensure_current_context();
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &gl_max_size);
+    // Every OpenGL implementation supports at least this size, so do not go below it.
+    gl_max_size = max<GLint>(gl_max_size, 64);
+  }
+  unsigned limit = min<unsigned>(gl_max_size, max_texture_size);
+  unsigned size = 64;
+  while (size * 2 <= limit) size *= 2;
+  return size;
+}
+
+void Gosu::Graphics::set_max_texture_size(unsigned size)
+{
+  max_texture_size = size;
+}
+
+void Gosu::Graphics::set_premultiplied_alpha(bool enabled)
+{
+  if (enabled == premultiplied) return;
+  if (!textures.empty())
+    throw logic_error("Premultiplied alpha must be set before any image is created");
+  premultiplied = enabled;
+}
+
+bool Gosu::Graphics::premultiplied_alpha()
+{
+  return premultiplied;
+}
+
+unique_ptr<Gosu::ImageData> Gosu::Graphics::create_image(const BitmapView& src,
   unsigned src_x, unsigned src_y, unsigned src_width, unsigned src_height, unsigned flags)
 {
-  static const unsigned max_size = MAX_TEXTURE_SIZE;
+  const unsigned max_size = texture_size();
   // Backward compatibility: This used to be 'bool tileable'.
   if (flags == 1) flags = IF_TILEABLE;
-  bool wants_retro = (flags & IF_RETRO);
-  // Special case: If the texture is supposed to have hard borders, is
-  // quadratic, has a size that is at least 64 pixels but no more than max_size
-  // pixels and a power of two, create a single texture just for this image.
+#ifdef GOSU_IS_OPENGLES
+  // OpenGL ES 1 cannot limit the number of mipmap levels.
+  flags &= ~IF_MIPMAP;
+#endif
+  // Mipmapped images live on their own textures, with a border that is still one pixel wide on
+  // the smallest level.
+  unsigned mip_levels = (flags & IF_MIPMAP) ? Texture::MIPMAP_LEVELS : 1;
+  unsigned padding = 1u << (mip_levels - 1);
+  // Likewise, images are only packed together with images of the same storage format. Retro
+  // images need textures with GL_NEAREST only where the retro shader program cannot sample them.
+  unsigned format = flags & Texture::FORMAT_FLAGS;
+  bool retro = (flags & IF_RETRO);
+  bool retro_texture = retro && !Texture::shares_retro_images(mip_levels, format);
+  // Tileable images share textures with everything else; the duplicated border that try_alloc
+  // adds gives them the same hard edges that a texture of their own would have.
+  // Special case: A tileable image that is exactly as large as a texture has no room for that
+  // border, so it gets a texture of its own instead of being split up.
   if ((flags & IF_TILEABLE) == IF_TILEABLE &&
-      src_width == src_height && (src_width & (src_width - 1)) == 0 &&
-      src_width >= 64 && src_width <= max_size) {
-    shared_ptr<Texture> texture(new Texture(src_width, src_height, wants_retro));
+      src_width == max_size && src_height == max_size) {
+    shared_ptr<Texture> texture(new Texture(src_width, src_height, mip_levels, format, retro));
     unique_ptr<ImageData> data;
-    // Use the source bitmap directly if the source area completely covers it.
-    if (src_x == 0 && src_width == src.width() &&
-        src_y == 0 && src_height == src.height()) {
-      Debug() << "Texture";
-      data = texture->try_alloc(src, 0);
-    } else {
-      Debug() << "Bitmap";
-      Bitmap bmp(src_width, src_height);
-      bmp.insert(src, 0, 0, src_x, src_y, src_width, src_height);
-      data = texture->try_alloc(bmp, 0);
-    }
+    data = texture->try_alloc(src, src_x, src_y, src_width, src_height, 0, flags);
     if (!data) throw logic_error("Internal texture block allocation error");
     return data;
   }
   // Too large to fit on a single texture.
-  if (src_width > max_size - 2 || src_height > max_size - 2) {
-    Bitmap bmp(src_width, src_height);
-    bmp.insert(src, 0, 0, src_x, src_y, src_width, src_height);
+  if (src_width > max_size - 2 * padding || src_height > max_size - 2 * padding) {
+    BitmapView portion = src.subview(src_x, src_y, src_width, src_height);
     unique_ptr<ImageData> lidi;
-    lidi.reset(new LargeImageData(bmp, max_size - 2, max_size - 2, flags));
+    lidi.reset(new LargeImageData(portion, max_size - 2 * padding, max_size - 2 * padding,
+                                  flags));
     return lidi;
   }
-  Bitmap bmp;//Debug() << "Not Tileable";
-  apply_border_flags(bmp, src, src_x, src_y, src_width, src_height, flags);
+  // Only the opaque part of a trimmed image goes onto the texture. Edges that were trimmed away
+  // were transparent, so they must not be made tileable.
+  unsigned trim_x = src_x, trim_y = src_y, trim_width = src_width, trim_height = src_height;
+  if (flags & IF_TRIM) {
+    trim_transparent_borders(src, trim_x, trim_y, trim_width, trim_height);
+    if (trim_x != src_x) flags &= ~IF_TILEABLE_LEFT;
+    if (trim_y != src_y) flags &= ~IF_TILEABLE_TOP;
+    if (trim_x + trim_width != src_x + src_width) flags &= ~IF_TILEABLE_RIGHT;
+    if (trim_y + trim_height != src_y + src_height) flags &= ~IF_TILEABLE_BOTTOM;
+  }
+  // Without an alpha channel, a transparent border would turn black, so repeat the edges.
+  if (flags & IF_RGB565) flags |= IF_TILEABLE;
   // Try to put the bitmap into one of the already allocated textures.
+  unique_ptr<TexChunk> data;
   for (const auto& texture : textures) {
-    if (texture->retro() != wants_retro) continue;
-    unique_ptr<ImageData> data = texture->try_alloc(bmp, 1);
-    if (data) return data;
+    if (texture->mip_levels() != mip_levels || texture->format() != format ||
+        texture->retro() != retro_texture) continue;
+    data = texture->try_alloc(src, trim_x, trim_y, trim_width, trim_height, padding, flags);
+    if (data) break;
   }
   // All textures are full: Create a new one.
-  shared_ptr<Texture> texture;
-  texture.reset(new Texture(max_size, max_size, wants_retro));
-  textures.push_back(texture);
-  unique_ptr<ImageData> data;
-  data = texture->try_alloc(bmp, 1);
-  if (!data.get()) throw logic_error("Internal texture block allocation error");
+  if (!data) {
+    shared_ptr<Texture> texture;
+    texture.reset(new Texture(max_size, max_size, mip_levels, format, retro_texture));
+    textures.push_back(texture);
+    data = texture->try_alloc(src, trim_x, trim_y, trim_width, trim_height, padding, flags);
+    if (!data.get()) throw logic_error("Internal texture block allocation error");
+  }
+  if (flags & IF_TRIM)
+    data->set_trim(trim_x - src_x, trim_y - src_y, src_width, src_height);
+  if (flags & IF_TIGHT_MESH)
+    data->build_mesh(src, trim_x, trim_y);
   return data;
 }
+
+vector<unique_ptr<Gosu::ImageData>> Gosu::Graphics::create_tiles(const BitmapView& src,
+  unsigned tile_width, unsigned tile_height, unsigned tiles_x, unsigned tiles_y, unsigned flags)
+{
+  const unsigned max_size = texture_size();
+  // Backward compatibility: This used to be 'bool tileable'.
+  if (flags == 1) flags = IF_TILEABLE;
+  // See create_image.
+  if (flags & IF_RGB565) flags |= IF_TILEABLE;
+  unsigned format = flags & Texture::FORMAT_FLAGS;
+  bool retro_texture = (flags & IF_RETRO) && !Texture::shares_retro_images(1, format);
+  vector<unique_ptr<ImageData>> tiles(tiles_x * tiles_y);
+  // Each tile is surrounded by the same one-pixel border that create_image would add.
+  unsigned cell_width = tile_width + 2, cell_height = tile_height + 2;
+  // Tiles that create_image would not put onto a shared texture are created one by one, and so
+  // are trimmed tiles, which all end up with different sizes, and mipmapped tiles, which need
+  // wider borders.
+  if (tile_width == 0 || tile_height == 0 ||
+      cell_width > max_size || cell_height > max_size || (flags & (IF_TRIM | IF_MIPMAP))) {
+    for (unsigned y = 0; y < tiles_y; ++y) {
+      for (unsigned x = 0; x < tiles_x; ++x) {
+        tiles[y * tiles_x + x] = create_image(src, x * tile_width, y * tile_height,
+                                              tile_width, tile_height, flags);
+      }
+    }
+    return tiles;
+  }
+  // Otherwise, lay out as many tiles as fit onto one texture in a single sheet, and upload each
+  // of these batches at once.
+  unsigned batch_columns = min(tiles_x, max_size / cell_width);
+  unsigned batch_rows    = min(tiles_y, max_size / cell_height);
+  for (unsigned batch_y = 0; batch_y < tiles_y; batch_y += batch_rows) {
+    for (unsigned batch_x = 0; batch_x < tiles_x; batch_x += batch_columns) {
+      unsigned columns = min(batch_columns, tiles_x - batch_x);
+      unsigned rows    = min(batch_rows,    tiles_y - batch_y);
+      Bitmap sheet(columns * cell_width, rows * cell_height);
+      for (unsigned y = 0; y < rows; ++y) {
+        for (unsigned x = 0; x < columns; ++x) {
+          apply_border_flags(sheet, x * cell_width, y * cell_height, src,
+                             (batch_x + x) * tile_width, (batch_y + y) * tile_height,
+                             tile_width, tile_height, flags);
+        }
+      }
+      // Try to put the sheet into one of the already allocated textures.
+      vector<unique_ptr<TexChunk>> chunks;
+      for (const auto& texture : textures) {
+        if (texture->mip_levels() != 1 || texture->format() != format ||
+            texture->retro() != retro_texture) continue;
+        chunks = texture->try_alloc_tiles(sheet, columns, rows, 1, flags);
+        if (!chunks.empty()) break;
+      }
+      // All textures are full: Create a new one.
+      if (chunks.empty()) {
+        shared_ptr<Texture> texture(new Texture(max_size, max_size, 1, format, retro_texture));
+        textures.push_back(texture);
+        chunks = texture->try_alloc_tiles(sheet, columns, rows, 1, flags);
+        if (chunks.empty()) throw logic_error("Internal texture block allocation error");
+      }
+      for (unsigned y = 0; y < rows; ++y) {
+        for (unsigned x = 0; x < columns; ++x) {
+          if (flags & IF_TIGHT_MESH)
+            chunks[y * columns + x]->build_mesh(sheet, x * cell_width + 1, y * cell_height + 1);
+          tiles[(batch_y + y) * tiles_x + batch_x + x] = move(chunks[y * columns + x]);
+        }
+      }
+    }
+  }
+  return tiles;
+}
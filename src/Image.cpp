@@ -6,6 +6,7 @@
 #include "Graphics.hpp"
 #include "IO.hpp"
 #include "ImageData.hpp"
+#include "LazyImageData.hpp"
 #include "Math.hpp"
 #include <stdexcept>
 #include "EmptyImageData.hpp"
@@ -16,9 +17,23 @@ Gosu::Image::Image()
 {}
 
 Gosu::Image::Image(const string& filename, unsigned flags)
+{
+  if (flags & IF_LAZY) {
+    data_.reset(new LazyImageData(filename, flags));
+    return;
+  }
+  // Forward.
+  Bitmap bmp;
+  load_image_file(bmp, filename);
+  Image(bmp, flags).data_.swap(data_);
+}
+
+Gosu::Image::Image(const string& filename, unsigned max_width, unsigned max_height,
+                   unsigned flags)
 { // Forward.
   Bitmap bmp;
   load_image_file(bmp, filename);
+  shrink_to_fit(bmp, max_width, max_height, (flags & IF_RETRO) ? RF_BOX : RF_LANCZOS);
   Image(bmp, flags).data_.swap(data_);
 }
 
@@ -30,12 +45,12 @@ Gosu::Image::Image(const string& filename, unsigned src_x, unsigned src_y,
   Image(bmp, src_x, src_y, src_width, src_height, flags).data_.swap(data_);
 }
 
-Gosu::Image::Image(const Bitmap& source, unsigned flags)
+Gosu::Image::Image(const BitmapView& source, unsigned flags)
 { // Forward.
   Image(source, 0, 0, source.width(), source.height(), flags).data_.swap(data_);
 }
 
-Gosu::Image::Image(const Bitmap& source, unsigned src_x, unsigned src_y,
+Gosu::Image::Image(const BitmapView& source, unsigned src_x, unsigned src_y,
                    unsigned src_width, unsigned src_height, unsigned flags)
 : data_(Graphics::create_image(source, src_x, src_y, src_width, src_height, flags))
 {}// Fourth Function is used!
@@ -95,12 +110,24 @@ void Gosu::Image::draw_rot(double x, double y, ZPos z, double angle,
               z, mode);
 }
 
+void Gosu::Image::prefetch() const
+{
+  data_->prefetch();
+}
+
 Gosu::ImageData& Gosu::Image::data() const
 {
   return *data_;
 }
 
-vector<Gosu::Image> Gosu::load_tiles(const Bitmap& bmp, int tile_width, int tile_height,
+future<Gosu::Bitmap> Gosu::ImageData::to_bitmap_async() const
+{
+  promise<Bitmap> result;
+  result.set_value(to_bitmap());
+  return result.get_future();
+}
+
+vector<Gosu::Image> Gosu::load_tiles(const BitmapView& bmp, int tile_width, int tile_height,
                                      unsigned flags)
 {
   int tiles_x, tiles_y;
@@ -117,10 +144,11 @@ vector<Gosu::Image> Gosu::load_tiles(const Bitmap& bmp, int tile_width, int tile
     tiles_y = -tile_height;
     tile_height = bmp.height() / tiles_y;
   }
-  for (int y = 0; y < tiles_y; ++y) {
-    for (int x = 0; x < tiles_x; ++x) {
-      images.emplace_back(bmp, x * tile_width, y * tile_height, tile_width, tile_height, flags);
-    }
+  vector<unique_ptr<ImageData>> tiles =
+    Graphics::create_tiles(bmp, tile_width, tile_height, tiles_x, tiles_y, flags);
+  images.reserve(tiles.size());
+  for (auto& tile : tiles) {
+    images.emplace_back(move(tile));
   }
   return images;
 }
@@ -0,0 +1,152 @@
+#include "ImageLoader.hpp"
+#include "Bitmap.hpp"
+#include "Image.hpp"
+#include "ThreadPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+using namespace std;
+
+struct Gosu::ImageLoader::Impl
+{
+  struct Job
+  {
+    string filename;
+    unsigned image_flags;
+    // Flipping as set on the thread that requested the image.
+    bool flip_h, flip_y;
+    Bitmap bitmap;
+    promise<Image> result;
+  };
+
+  mutable mutex job_mutex;
+  condition_variable job_done;
+  // Jobs whose files have been decoded, waiting for the thread that draws.
+  deque<shared_ptr<Job>> decoded;
+  unsigned requested = 0, finished = 0;
+  // Set when the loader goes away, so that workers skip the files they have not started yet.
+  atomic<bool> abandoned{false};
+
+  void decode(const shared_ptr<Job>& job)
+  {
+    if (abandoned) return;
+    try {
+      load_image_file(job->bitmap, job->filename, job->flip_h, job->flip_y);
+    }
+    catch (...) {
+      job->result.set_exception(current_exception());
+      lock_guard<mutex> lock(job_mutex);
+      ++finished;
+      job_done.notify_all();
+      return;
+    }
+    lock_guard<mutex> lock(job_mutex);
+    decoded.push_back(job);
+    job_done.notify_all();
+  }
+
+  // Creates the image of one decoded job. Returns false if there is none.
+  bool finalize_one()
+  {
+    shared_ptr<Job> job;
+    {
+      lock_guard<mutex> lock(job_mutex);
+      if (decoded.empty()) return false;
+      job = move(decoded.front());
+      decoded.pop_front();
+    }
+    try {
+      job->result.set_value(Image(job->bitmap, job->image_flags));
+    }
+    catch (...) {
+      job->result.set_exception(current_exception());
+    }
+    lock_guard<mutex> lock(job_mutex);
+    ++finished;
+    return true;
+  }
+};
+
+Gosu::ImageLoader::ImageLoader()
+: pimpl(make_shared<Impl>())
+{
+}
+
+Gosu::ImageLoader::~ImageLoader()
+{
+  pimpl->abandoned = true;
+  lock_guard<mutex> lock(pimpl->job_mutex);
+  pimpl->decoded.clear();
+}
+
+shared_future<Gosu::Image> Gosu::ImageLoader::load(const string& filename,
+  unsigned image_flags)
+{
+  bool flip_h = flip_h_enabled();
+  // This counts as loading the image, see enable_flip_h.
+  enable_flip_h(false);
+  return load(filename, image_flags, flip_h, flip_y_enabled());
+}
+
+shared_future<Gosu::Image> Gosu::ImageLoader::load(const string& filename,
+  unsigned image_flags, bool flip_h, bool flip_y)
+{
+  shared_ptr<Impl::Job> job = make_shared<Impl::Job>();
+  job->filename = filename;
+  job->image_flags = image_flags;
+  job->flip_h = flip_h;
+  job->flip_y = flip_y;
+  shared_future<Image> result = job->result.get_future().share();
+  {
+    lock_guard<mutex> lock(pimpl->job_mutex);
+    ++pimpl->requested;
+  }
+  // The task keeps the Impl alive, in case the loader is destroyed first.
+  shared_ptr<Impl> impl = pimpl;
+  run_in_background([impl, job] { impl->decode(job); });
+  return result;
+}
+
+void Gosu::ImageLoader::update(double max_milliseconds)
+{
+  auto start = chrono::steady_clock::now();
+  while (pimpl->finalize_one()) {
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    if (elapsed.count() >= max_milliseconds) break;
+  }
+}
+
+void Gosu::ImageLoader::wait()
+{
+  for (;;) {
+    {
+      unique_lock<mutex> lock(pimpl->job_mutex);
+      pimpl->job_done.wait(lock, [this] {
+        return !pimpl->decoded.empty() || pimpl->finished == pimpl->requested;
+      });
+      if (pimpl->decoded.empty()) return;
+    }
+    pimpl->finalize_one();
+  }
+}
+
+unsigned Gosu::ImageLoader::requested() const
+{
+  lock_guard<mutex> lock(pimpl->job_mutex);
+  return pimpl->requested;
+}
+
+unsigned Gosu::ImageLoader::finished() const
+{
+  lock_guard<mutex> lock(pimpl->job_mutex);
+  return pimpl->finished;
+}
+
+double Gosu::ImageLoader::progress() const
+{
+  lock_guard<mutex> lock(pimpl->job_mutex);
+  return pimpl->requested == 0 ? 1 : 1.0 * pimpl->finished / pimpl->requested;
+}
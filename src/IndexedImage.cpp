@@ -0,0 +1,296 @@
+#include "IndexedImage.hpp"
+#include "Bitmap.hpp"
+#include "Graphics.hpp"
+#include "GraphicsImpl.hpp"
+#include "TexChunk.hpp"
+#include "Texture.hpp"
+#include <stdexcept>
+#include <string>
+using namespace std;
+
+namespace Gosu
+{
+  namespace
+  {
+    unsigned palette_count = 0;
+  }
+}
+
+#ifndef GOSU_IS_OPENGLES
+namespace Gosu
+{
+  namespace
+  {
+    // All palettes live in one texture, one palette per row.
+    GLuint palette_texture = 0;
+
+    GLuint palette_program = 0;
+    GLint texture_size_location, palette_row_location;
+
+    // Built on first use; see retro_program_available.
+    GLuint retro_program = 0;
+    bool retro_program_failed = false;
+    GLint retro_texture_size_location;
+
+    const char* VERTEX_SHADER =
+      "void main()\n"
+      "{\n"
+      "  gl_Position = ftransform();\n"
+      "  gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+      "  gl_FrontColor = gl_Color;\n"
+      "}\n";
+
+    // Indices must not be interpolated, so the fragment shader always samples the center of the
+    // nearest texel, whatever filter the texture uses.
+    const char* FRAGMENT_SHADER =
+      "uniform sampler2D indices;\n"
+      "uniform sampler2D palettes;\n"
+      "uniform vec2 texture_size;\n"
+      "uniform float palette_row;\n"
+      "void main()\n"
+      "{\n"
+      "  vec2 texel = (floor(gl_TexCoord[0].xy * texture_size) + 0.5) / texture_size;\n"
+      "  float index = texture2D(indices, texel).a * 255.0;\n"
+      "  vec2 entry = vec2((index + 0.5) / 256.0, palette_row);\n"
+      "  gl_FragColor = texture2D(palettes, entry) * gl_Color;\n"
+      "}\n";
+
+    // Retro images share textures with smooth ones. Their vertices carry 1 in the third texture
+    // coordinate, which makes the shader sample the center of the nearest texel, like GL_NEAREST.
+    const char* RETRO_FRAGMENT_SHADER =
+      "uniform sampler2D texture;\n"
+      "uniform vec2 texture_size;\n"
+      "void main()\n"
+      "{\n"
+      "  vec2 coord = gl_TexCoord[0].xy;\n"
+      "  if (gl_TexCoord[0].z > 0.5)\n"
+      "    coord = (floor(coord * texture_size) + 0.5) / texture_size;\n"
+      "  gl_FragColor = texture2D(texture, coord) * gl_Color;\n"
+      "}\n";
+
+    GLuint compile_shader(GLenum type, const char* source)
+    {
+      GOSU_LOAD_GL_EXT(glCreateShader, PFNGLCREATESHADERPROC);
+      GOSU_LOAD_GL_EXT(glShaderSource, PFNGLSHADERSOURCEPROC);
+      GOSU_LOAD_GL_EXT(glCompileShader, PFNGLCOMPILESHADERPROC);
+      GOSU_LOAD_GL_EXT(glGetShaderiv, PFNGLGETSHADERIVPROC);
+      GOSU_LOAD_GL_EXT(glGetShaderInfoLog, PFNGLGETSHADERINFOLOGPROC);
+
+      GLuint shader = glCreateShader(type);
+      glShaderSource(shader, 1, &source, nullptr);
+      glCompileShader(shader);
+      GLint status;
+      glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+      if (status != GL_TRUE) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof log, nullptr, log);
+        throw runtime_error("Could not compile shader: " + string(log));
+      }
+      return shader;
+    }
+
+    GLuint link_program(const char* fragment_shader)
+    {
+      GOSU_LOAD_GL_EXT(glCreateProgram, PFNGLCREATEPROGRAMPROC);
+      GOSU_LOAD_GL_EXT(glAttachShader, PFNGLATTACHSHADERPROC);
+      GOSU_LOAD_GL_EXT(glLinkProgram, PFNGLLINKPROGRAMPROC);
+      GOSU_LOAD_GL_EXT(glGetProgramiv, PFNGLGETPROGRAMIVPROC);
+
+      ensure_current_context();
+      GLuint program = glCreateProgram();
+      glAttachShader(program, compile_shader(GL_VERTEX_SHADER, VERTEX_SHADER));
+      glAttachShader(program, compile_shader(GL_FRAGMENT_SHADER, fragment_shader));
+      glLinkProgram(program);
+      GLint status;
+      glGetProgramiv(program, GL_LINK_STATUS, &status);
+      if (status != GL_TRUE) throw runtime_error("Could not link shader");
+      return program;
+    }
+
+    void ensure_palette_program()
+    {
+      if (palette_program != 0) return;
+
+      GOSU_LOAD_GL_EXT(glUseProgram, PFNGLUSEPROGRAMPROC);
+      GOSU_LOAD_GL_EXT(glGetUniformLocation, PFNGLGETUNIFORMLOCATIONPROC);
+      GOSU_LOAD_GL_EXT(glUniform1i, PFNGLUNIFORM1IPROC);
+
+      GLuint program = link_program(FRAGMENT_SHADER);
+      glUseProgram(program);
+      glUniform1i(glGetUniformLocation(program, "indices"), 0);
+      glUniform1i(glGetUniformLocation(program, "palettes"), 1);
+      texture_size_location = glGetUniformLocation(program, "texture_size");
+      palette_row_location  = glGetUniformLocation(program, "palette_row");
+      glUseProgram(0);
+      palette_program = program;
+    }
+
+    void ensure_palette_texture()
+    {
+      if (palette_texture != 0) return;
+
+      ensure_current_context();
+      glGenTextures(1, &palette_texture);
+      glBindTexture(GL_TEXTURE_2D, palette_texture);
+      glTexImage2D(GL_TEXTURE_2D, 0, 4, IndexedImage::PALETTE_SIZE, IndexedImage::MAX_PALETTES,
+                   0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+  }
+}
+
+bool Gosu::retro_program_available()
+{
+  if (retro_program != 0) return true;
+  // Don't retry (and fail) for every image if the driver cannot build the program.
+  if (retro_program_failed) return false;
+
+  try {
+    GOSU_LOAD_GL_EXT(glUseProgram, PFNGLUSEPROGRAMPROC);
+    GOSU_LOAD_GL_EXT(glGetUniformLocation, PFNGLGETUNIFORMLOCATIONPROC);
+    GOSU_LOAD_GL_EXT(glUniform1i, PFNGLUNIFORM1IPROC);
+
+    GLuint program = link_program(RETRO_FRAGMENT_SHADER);
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "texture"), 0);
+    retro_texture_size_location = glGetUniformLocation(program, "texture_size");
+    glUseProgram(0);
+    retro_program = program;
+    return true;
+  }
+  catch (const runtime_error&) {
+    retro_program_failed = true;
+    return false;
+  }
+}
+
+void Gosu::apply_shader_program(int palette, const Texture* texture)
+{
+  // Nothing to undo if no shader program has ever been built.
+  if (palette_program == 0 && retro_program == 0) return;
+
+  GOSU_LOAD_GL_EXT(glUseProgram, PFNGLUSEPROGRAMPROC);
+  GOSU_LOAD_GL_EXT(glUniform2f, PFNGLUNIFORM2FPROC);
+  GOSU_LOAD_GL_EXT(glUniform1f, PFNGLUNIFORM1FPROC);
+  GOSU_LOAD_GL_EXT(glActiveTexture, PFNGLACTIVETEXTUREPROC);
+
+  if (!texture) {
+    glUseProgram(0);
+    return;
+  }
+  if (palette == NO_PALETTE) {
+    if (texture->has_retro_images()) {
+      glUseProgram(retro_program);
+      glUniform2f(retro_texture_size_location, texture->width(), texture->height());
+    }
+    else {
+      glUseProgram(0);
+    }
+    return;
+  }
+  glUseProgram(palette_program);
+  glUniform2f(texture_size_location, texture->width(), texture->height());
+  glUniform1f(palette_row_location, (palette + 0.5) / IndexedImage::MAX_PALETTES);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, palette_texture);
+  glActiveTexture(GL_TEXTURE0);
+}
+#else
+bool Gosu::retro_program_available()
+{
+  return false;
+}
+
+void Gosu::apply_shader_program(int palette, const Texture* texture)
+{
+}
+#endif
+
+Gosu::IndexedImage::IndexedImage(unsigned width, unsigned height,
+  const vector<uint8_t>& indices, unsigned flags)
+{
+#ifdef GOSU_IS_OPENGLES
+  throw logic_error("Indexed images are not supported on OpenGL ES");
+#else
+  if (indices.size() != width * height)
+    throw invalid_argument("Number of indices does not match the size of the image");
+  ensure_palette_program();
+  // The indices are stored in the alpha channel of an alpha-only texture.
+  Bitmap bmp(width, height);
+  for (unsigned i = 0; i < indices.size(); ++i)
+    bmp.pixels[i] = Color(indices[i], 0, 0, 0);
+  flags = (flags & IF_TILEABLE) | IF_ALPHA8 | IF_RETRO;
+  data_ = Graphics::create_image(bmp, 0, 0, width, height, flags);
+  if (!dynamic_cast<TexChunk*>(data_.get()))
+    throw invalid_argument("Indexed images must fit onto a single texture");
+#endif
+}
+
+Gosu::IndexedImage::IndexedImage(const Bitmap& source, const vector<Color>& palette,
+  unsigned flags)
+: IndexedImage(source.width(), source.height(),
+               [&] {
+                 vector<uint8_t> indices(source.pixels.size());
+                 for (unsigned i = 0; i < indices.size(); ++i) {
+                   unsigned index = 0;
+                   while (index < palette.size() && index < PALETTE_SIZE &&
+                          palette[index] != source.pixels[i]) ++index;
+                   if (index == palette.size() || index == PALETTE_SIZE)
+                     throw invalid_argument("Bitmap contains a color that is not in the palette");
+                   indices[i] = index;
+                 }
+                 return indices;
+               }(), flags)
+{
+}
+
+unsigned Gosu::IndexedImage::width() const
+{
+  return data_->width();
+}
+
+unsigned Gosu::IndexedImage::height() const
+{
+  return data_->height();
+}
+
+void Gosu::IndexedImage::draw(double x, double y, ZPos z, unsigned palette, double scale_x,
+  double scale_y, Color c, AlphaMode mode) const
+{
+  if (palette >= palette_count)
+    throw invalid_argument("Invalid palette id");
+  double x2 = x + width() * scale_x;
+  double y2 = y + height() * scale_y;
+  static_cast<const TexChunk&>(*data_).draw(x, y, c, x2, y, c, x, y2, c, x2, y2, c, z, mode,
+                                            palette);
+}
+
+unsigned Gosu::IndexedImage::create_palette(const vector<Color>& colors)
+{
+  if (palette_count == MAX_PALETTES)
+    throw runtime_error("Too many palettes");
+  set_palette(palette_count++, colors);
+  return palette_count - 1;
+}
+
+void Gosu::IndexedImage::set_palette(unsigned palette, const vector<Color>& colors)
+{
+  if (palette >= palette_count)
+    throw invalid_argument("Invalid palette id");
+  if (colors.size() > PALETTE_SIZE)
+    throw invalid_argument("Too many colors for one palette");
+#ifndef GOSU_IS_OPENGLES
+  ensure_palette_texture();
+  vector<Color> row(colors);
+  row.resize(PALETTE_SIZE, Color::NONE);
+  if (Graphics::premultiplied_alpha()) {
+    for (Color& c : row) c = premultiply(c);
+  }
+  glBindTexture(GL_TEXTURE_2D, palette_texture);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, palette, PALETTE_SIZE, 1, Color::GL_FORMAT,
+                  GL_UNSIGNED_BYTE, row.data());
+#endif
+}
@@ -5,7 +5,7 @@
 #include <cmath>
 using namespace std;
 
-Gosu::LargeImageData::LargeImageData(const Bitmap& source, int tile_width, int tile_height,
+Gosu::LargeImageData::LargeImageData(const BitmapView& source, int tile_width, int tile_height,
                                      unsigned image_flags)
 {
     w = source.width();
@@ -162,7 +162,7 @@ Gosu::Bitmap Gosu::LargeImageData::to_bitmap() const
   return bitmap;
 }
 
-void Gosu::LargeImageData::insert(const Bitmap& bitmap, int at_x, int at_y)
+void Gosu::LargeImageData::insert(const BitmapView& bitmap, int at_x, int at_y)
 {
   int y = 0;
   for (int ty = 0; ty < tiles_y; ++ty) {
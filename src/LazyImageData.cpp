@@ -0,0 +1,88 @@
+#include "LazyImageData.hpp"
+#include "Graphics.hpp"
+#include "ThreadPool.hpp"
+#include <exception>
+#include <stdexcept>
+using namespace std;
+
+Gosu::LazyImageData::LazyImageData(const string& filename, unsigned image_flags)
+: filename(filename), image_flags(image_flags & ~IF_LAZY),
+  flip_h(flip_h_enabled()), flip_y(flip_y_enabled())
+{
+  // This counts as loading the image, see enable_flip_h.
+  enable_flip_h(false);
+  load_image_size(filename, w, h);
+}
+
+Gosu::ImageData& Gosu::LazyImageData::resolve() const
+{
+  if (data) return *data;
+
+  Bitmap bmp;
+  if (decoded.valid()) {
+    bmp = decoded.get();
+  }
+  else {
+    load_image_file(bmp, filename, flip_h, flip_y);
+  }
+  // Other images may already have been laid out around this one's size.
+  if (bmp.width() != w || bmp.height() != h)
+    throw runtime_error("Image file has changed since it was opened: " + filename);
+  data = Graphics::create_image(bmp, 0, 0, w, h, image_flags);
+  return *data;
+}
+
+void Gosu::LazyImageData::draw(double x1, double y1, Color c1,
+                               double x2, double y2, Color c2,
+                               double x3, double y3, Color c3,
+                               double x4, double y4, Color c4,
+                               ZPos z, AlphaMode mode) const
+{
+  resolve().draw(x1, y1, c1, x2, y2, c2, x3, y3, c3, x4, y4, c4, z, mode);
+}
+
+const Gosu::GLTexInfo* Gosu::LazyImageData::gl_tex_info() const
+{
+  return resolve().gl_tex_info();
+}
+
+Gosu::Bitmap Gosu::LazyImageData::to_bitmap() const
+{
+  return resolve().to_bitmap();
+}
+
+future<Gosu::Bitmap> Gosu::LazyImageData::to_bitmap_async() const
+{
+  return resolve().to_bitmap_async();
+}
+
+void Gosu::LazyImageData::prefetch() const
+{
+  if (data || decoded.valid()) return;
+
+  shared_ptr<promise<Bitmap>> result = make_shared<promise<Bitmap>>();
+  decoded = result->get_future();
+  string filename = this->filename;
+  bool flip_h = this->flip_h, flip_y = this->flip_y;
+  run_in_background([result, filename, flip_h, flip_y] {
+    try {
+      Bitmap bmp;
+      load_image_file(bmp, filename, flip_h, flip_y);
+      result->set_value(move(bmp));
+    }
+    catch (...) {
+      result->set_exception(current_exception());
+    }
+  });
+}
+
+unique_ptr<Gosu::ImageData> Gosu::LazyImageData::subimage(int x, int y, int width,
+                                                          int height) const
+{
+  return resolve().subimage(x, y, width, height);
+}
+
+void Gosu::LazyImageData::insert(const BitmapView& bitmap, int x, int y)
+{
+  resolve().insert(bitmap, x, y);
+}
@@ -178,7 +178,14 @@ struct Gosu::Macro::Impl
             glPushMatrix();
             vertex_array.render_state.apply();
             glMultMatrixd(&transform[0]);
-            glInterleavedArrays(GL_T2F_C4UB_V3F, 0, &vertex_array.vertices[0]);
+            // Not glInterleavedArrays: GL_T2F_C4UB_V3F has no room for the retro coordinate.
+            const ArrayVertex* first = &vertex_array.vertices[0];
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+            glEnableClientState(GL_COLOR_ARRAY);
+            glEnableClientState(GL_VERTEX_ARRAY);
+            glTexCoordPointer(3, GL_FLOAT, sizeof(ArrayVertex), first->tex_coords);
+            glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ArrayVertex), &first->color);
+            glVertexPointer(3, GL_FLOAT, sizeof(ArrayVertex), first->vertices);
             glDrawArrays(GL_QUADS, 0, (GLsizei) vertex_array.vertices.size());
             glPopMatrix();
         }
@@ -237,7 +244,7 @@ unique_ptr<Gosu::ImageData> Gosu::Macro::subimage(int x, int y, int width, int h
     return unique_ptr<ImageData>();
 }
 
-void Gosu::Macro::insert(const Bitmap& bitmap, int x, int y)
+void Gosu::Macro::insert(const BitmapView& bitmap, int x, int y)
 {
     throw logic_error("Gosu::Macro cannot be updated with a Gosu::Bitmap yet");
 }
@@ -7,27 +7,6 @@
 #endif
 using namespace std;
 
-#ifdef GOSU_IS_OPENGLES
-    #define GOSU_LOAD_GL_EXT(fn, type) \
-        static auto fn = fn ## OES;
-
-    #define GOSU_GL_CONST(name) \
-        name ## _OES
-
-    #define GOSU_GL_DEPTH_COMPONENT \
-        GL_DEPTH_COMPONENT16_OES
-#else
-    #define GOSU_LOAD_GL_EXT(fn, type) \
-        static auto fn = (type) SDL_GL_GetProcAddress(#fn); \
-        if (!fn) throw runtime_error("Unable to load " #fn);
-
-    #define GOSU_GL_CONST(name) \
-        name
-
-    #define GOSU_GL_DEPTH_COMPONENT \
-        GL_DEPTH_COMPONENT
-#endif
-
 Gosu::OffScreenTarget::OffScreenTarget(int width, int height, unsigned image_flags)
 {
 #ifndef GOSU_IS_IPHONE
@@ -37,7 +16,7 @@ Gosu::OffScreenTarget::OffScreenTarget(int width, int height, unsigned image_fla
 #endif
     
     // Create a new texture that will be our rendering target.
-    texture = make_shared<Texture>(width, height, image_flags & IF_RETRO);
+    texture = make_shared<Texture>(width, height, 1, 0, image_flags & IF_RETRO);
     // Mark the full texture as blocked for our TexChunk.
     texture->block(0, 0, width, height);
     
@@ -91,9 +70,12 @@ Gosu::Image Gosu::OffScreenTarget::render(const std::function<void ()>& f)
     GLenum status = glCheckFramebufferStatus(GOSU_GL_CONST(GL_FRAMEBUFFER));
     if (status != GOSU_GL_CONST(GL_FRAMEBUFFER_COMPLETE)) throw runtime_error("Incomplete framebuffer");
     
+    // Rendering bypasses the texture's shadow copy, which would be stale afterwards.
+    texture->release_shadow();
     f();
     glBindFramebuffer(GOSU_GL_CONST(GL_FRAMEBUFFER), 0);
 
-    unique_ptr<ImageData> tex_chunk(new TexChunk(texture, 0, 0, texture->width(), texture->height(), 0));
+    unique_ptr<ImageData> tex_chunk(new TexChunk(texture, 0, 0, texture->width(),
+                                                 texture->height(), 0, false));
     return Image(move(tex_chunk));
 }
@@ -2701,6 +2701,22 @@ static VALUE get_hash_value(VALUE options, char *name)
   return rb_hash_delete(options, rb_id2sym(rb_intern(name)));
 }
 
+static unsigned image_format_flags(VALUE format)
+{
+  const char* cstr = Gosu::cstr_from_symbol(format);
+  if (!strcmp(cstr, "rgba8"))
+    return 0;
+  else if (!strcmp(cstr, "alpha8"))
+    return Gosu::IF_ALPHA8;
+  else if (!strcmp(cstr, "rgb565"))
+    return Gosu::IF_RGB565;
+  else if (!strcmp(cstr, "rgba4444"))
+    return Gosu::IF_RGBA4444;
+  rb_raise(rb_eArgError, "Argument passed to :format must be a valid image format "
+           "(:rgba8, :alpha8, :rgb565, :rgba4444)");
+  return 0;
+}
+
 SWIGINTERN Gosu::Image *new_Gosu_Image(VALUE source, VALUE options=0) {
   Gosu::Bitmap bmp;
   unsigned flags = 0, src_x = 0, src_y = 0;
@@ -2711,16 +2727,35 @@ SWIGINTERN Gosu::Image *new_Gosu_Image(VALUE source, VALUE options=0) {
       flags |= Gosu::IF_TILEABLE;
     if (get_hash_value(options, "retro") == Qtrue)
       flags |= Gosu::IF_RETRO;
-    if (get_hash_value(options, "flip_h") == Qtrue)
+    if (get_hash_value(options, "trim") == Qtrue)
+      flags |= Gosu::IF_TRIM;
+    if (get_hash_value(options, "tight_mesh") == Qtrue)
+      flags |= Gosu::IF_TIGHT_MESH;
+    if (get_hash_value(options, "mipmap") == Qtrue)
+      flags |= Gosu::IF_MIPMAP;
+    VALUE format = get_hash_value(options, "format");
+    if (!NIL_P(format))
+      flags |= image_format_flags(format);
+    // get_hash_value removes each option from the hash, so read them all exactly once.
+    VALUE lazy = get_hash_value(options, "lazy");
+    VALUE flip_h = get_hash_value(options, "flip_h");
+    VALUE flip_y = get_hash_value(options, "flip_y");
+    VALUE invert = get_hash_value(options, "invert");
+    VALUE ary = get_hash_value(options, "rect");
+    VALUE max_size = get_hash_value(options, "max_size");
+    // Lazy images are decoded later, so only whole files without any processing qualify.
+    if (lazy == Qtrue && RB_TYPE_P(source, T_STRING) && NIL_P(ary) && NIL_P(max_size) &&
+        !RTEST(flip_h) && !RTEST(flip_y) && !RTEST(invert))
+      return new Gosu::Image(StringValueCStr(source), flags | Gosu::IF_LAZY);
+    if (flip_h == Qtrue)
       Gosu::enable_flip_h(true);
-    if (get_hash_value(options, "flip_y") == Qtrue)
+    if (flip_y == Qtrue)
       Gosu::enable_flip_y(true);
-    if (get_hash_value(options, "invert") == Qtrue) {
+    if (invert == Qtrue) {
       normal_color = 0;
       std::string fn = StringValueCStr(source);
       Gosu::load_image_inverse_color(bmp, fn);
     }
-    VALUE ary = get_hash_value(options, "rect");
     if (RB_TYPE_P(ary, T_ARRAY)) {
       if (rb_array_len(ary) != 4)
         rb_raise(rb_eArgError, "Argument passed to :rect must be a four-element "
@@ -2731,6 +2766,14 @@ SWIGINTERN Gosu::Image *new_Gosu_Image(VALUE source, VALUE options=0) {
       src_height = NUM2INT(rb_ary_entry(ary, 3));
     }
     if (normal_color) Gosu::load_bitmap(bmp, source);
+    if (RB_TYPE_P(max_size, T_ARRAY)) {
+      if (rb_array_len(max_size) != 2)
+        rb_raise(rb_eArgError, "Argument passed to :max_size must be a two-element "
+                               "Array [width, height]");
+      Gosu::shrink_to_fit(bmp, NUM2UINT(rb_ary_entry(max_size, 0)),
+                          NUM2UINT(rb_ary_entry(max_size, 1)),
+                          (flags & Gosu::IF_RETRO) ? Gosu::RF_BOX : Gosu::RF_LANCZOS);
+    }
     src_width = bmp.width();
     src_height = bmp.height();
   }
@@ -2843,11 +2886,19 @@ SWIGINTERN std::vector< Gosu::Image > Gosu_Image_load_tiles__SWIG_0(VALUE source
       VALUE key = rb_ary_entry(keys, i);
       const char* key_string = Gosu::cstr_from_symbol(key);
       VALUE value = rb_hash_aref(options, key);
-      if (!strcmp(key_string, "tileable"))
+      if (!strcmp(key_string, "tileable")) {
         if (RTEST(value)) flags |= Gosu::IF_TILEABLE;
-      else if (!strcmp(key_string, "retro"))
+      } else if (!strcmp(key_string, "retro")) {
         if (RTEST(value)) flags |= Gosu::IF_RETRO;
-      else {
+      } else if (!strcmp(key_string, "trim")) {
+        if (RTEST(value)) flags |= Gosu::IF_TRIM;
+      } else if (!strcmp(key_string, "tight_mesh")) {
+        if (RTEST(value)) flags |= Gosu::IF_TIGHT_MESH;
+      } else if (!strcmp(key_string, "mipmap")) {
+        if (RTEST(value)) flags |= Gosu::IF_MIPMAP;
+      } else if (!strcmp(key_string, "format")) {
+        flags |= image_format_flags(value);
+      } else {
         static bool issued_warning = false;
         if (!issued_warning) {
           issued_warning = true;
@@ -3618,6 +3669,45 @@ fail:
   return Qnil;
 }
 
+SWIGINTERN VALUE _wrap_texture_size(VALUE self) {
+  unsigned int result;
+  try {
+    result = Gosu::Graphics::texture_size();
+  } catch (const std::exception& e) {
+    SWIG_exception(SWIG_RuntimeError, e.what());
+  }
+  return SWIG_From_unsigned_SS_int(result);
+fail:
+  return Qnil;
+}
+
+SWIGINTERN VALUE _wrap_set_max_texture_size(VALUE self, VALUE size) {
+  unsigned int val;
+  int ecode = SWIG_AsVal_unsigned_SS_int(size, &val);
+  if (!SWIG_IsOK(ecode)) {
+    SWIG_exception_fail(SWIG_ArgError(ecode), Ruby_Format_TypeError("", "unsigned int", "max_texture_size=", 1, size));
+  }
+  Gosu::Graphics::set_max_texture_size(val);
+  return size;
+fail:
+  return Qnil;
+}
+
+SWIGINTERN VALUE _wrap_premultiplied_alpha(VALUE self) {
+  return SWIG_From_bool(Gosu::Graphics::premultiplied_alpha());
+}
+
+SWIGINTERN VALUE _wrap_set_premultiplied_alpha(VALUE self, VALUE enabled) {
+  try {
+    Gosu::Graphics::set_premultiplied_alpha(RTEST(enabled));
+  } catch (const std::exception& e) {
+    SWIG_exception(SWIG_RuntimeError, e.what());
+  }
+  return enabled;
+fail:
+  return Qnil;
+}
+
 SWIGINTERN VALUE _wrap__release_all_openal_resources(VALUE self) {
   try {
     Gosu::al_shutdown();
@@ -6925,6 +7015,142 @@ free_Gosu_Image(void *self) {
     delete arg1;
 }
 
+SWIGINTERN VALUE _wrap_Image_prefetch(VALUE self)
+{
+  Gosu::Image *arg1 = (Gosu::Image *) 0;
+  void *argp1 = 0;
+  int res1 = SWIG_ConvertPtr(self, &argp1, SWIGTYPE_p_Gosu__Image, 0 | 0);
+  if (!SWIG_IsOK(res1))
+    SWIG_exception_fail(SWIG_ArgError(res1), Ruby_Format_TypeError("", "Gosu::Image const *", "prefetch", 1, self));
+  arg1 = reinterpret_cast< Gosu::Image * >(argp1);
+  try {
+    arg1->prefetch();
+  } catch (const std::exception& e) {
+    SWIG_exception(SWIG_RuntimeError, e.what());
+  }
+  return self;
+fail:
+  return Qnil;
+}
+
+// Gosu::ImageLoader is not wrapped by SWIG. Ruby cannot wait on C++ futures, so #load returns
+// an index, and #[] returns the image once it has been created.
+struct RubyImageLoader
+{
+  Gosu::ImageLoader loader;
+  std::vector<std::shared_future<Gosu::Image>> images;
+};
+
+SWIGINTERN void free_ImageLoader(void *self) {
+  delete static_cast<RubyImageLoader *>(self);
+}
+
+SWIGINTERN RubyImageLoader *get_ImageLoader(VALUE self) {
+  RubyImageLoader *loader;
+  Data_Get_Struct(self, RubyImageLoader, loader);
+  return loader;
+}
+
+SWIGINTERN VALUE _wrap_ImageLoader_allocate(VALUE klass) {
+  return Data_Wrap_Struct(klass, 0, free_ImageLoader, new RubyImageLoader);
+}
+
+SWIGINTERN VALUE _wrap_ImageLoader_load(int argc, VALUE *argv, VALUE self) {
+  if (argc < 1 || argc > 2)
+    rb_raise(rb_eArgError, "wrong # of arguments(%d for 1)", argc);
+  RubyImageLoader *arg1 = get_ImageLoader(self);
+  VALUE options = argc > 1 ? argv[1] : Qnil;
+  unsigned flags = 0;
+  if (RB_TYPE_P(options, T_HASH)) {
+    if (get_hash_value(options, "tileable") == Qtrue)
+      flags |= Gosu::IF_TILEABLE;
+    if (get_hash_value(options, "retro") == Qtrue)
+      flags |= Gosu::IF_RETRO;
+    if (get_hash_value(options, "trim") == Qtrue)
+      flags |= Gosu::IF_TRIM;
+    if (get_hash_value(options, "tight_mesh") == Qtrue)
+      flags |= Gosu::IF_TIGHT_MESH;
+    if (get_hash_value(options, "mipmap") == Qtrue)
+      flags |= Gosu::IF_MIPMAP;
+    VALUE format = get_hash_value(options, "format");
+    if (!NIL_P(format))
+      flags |= image_format_flags(format);
+  }
+  try {
+    // Like Image.new, ignore any flipping left over from earlier calls.
+    arg1->images.push_back(arg1->loader.load(StringValueCStr(argv[0]), flags, false, false));
+  } catch (const std::exception& e) {
+    SWIG_exception(SWIG_RuntimeError, e.what());
+  }
+  return UINT2NUM(arg1->images.size() - 1);
+fail:
+  return Qnil;
+}
+
+SWIGINTERN VALUE _wrap_ImageLoader_get(VALUE self, VALUE index) {
+  RubyImageLoader *arg1 = get_ImageLoader(self);
+  unsigned i = NUM2UINT(index);
+  if (i >= arg1->images.size())
+    rb_raise(rb_eIndexError, "no image has been requested with index %u", i);
+  const std::shared_future<Gosu::Image>& image = arg1->images[i];
+  if (image.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return Qnil;
+  try {
+    return SWIG_NewPointerObj(new Gosu::Image(image.get()), SWIGTYPE_p_Gosu__Image,
+                              SWIG_POINTER_OWN);
+  } catch (const std::exception& e) {
+    SWIG_exception(SWIG_RuntimeError, e.what());
+  }
+fail:
+  return Qnil;
+}
+
+SWIGINTERN VALUE _wrap_ImageLoader_update(int argc, VALUE *argv, VALUE self) {
+  if (argc > 1)
+    rb_raise(rb_eArgError, "wrong # of arguments(%d for 0)", argc);
+  RubyImageLoader *arg1 = get_ImageLoader(self);
+  try {
+    arg1->loader.update(argc > 0 ? NUM2DBL(argv[0]) : 2);
+  } catch (const std::exception& e) {
+    SWIG_exception(SWIG_RuntimeError, e.what());
+  }
+  return Qnil;
+fail:
+  return Qnil;
+}
+
+SWIGINTERN VALUE _wrap_ImageLoader_wait(VALUE self) {
+  try {
+    get_ImageLoader(self)->loader.wait();
+  } catch (const std::exception& e) {
+    SWIG_exception(SWIG_RuntimeError, e.what());
+  }
+  return self;
+fail:
+  return Qnil;
+}
+
+SWIGINTERN VALUE _wrap_ImageLoader_progress(VALUE self) {
+  return DBL2NUM(get_ImageLoader(self)->loader.progress());
+}
+
+SWIGINTERN VALUE _wrap_ImageLoader_requested(VALUE self) {
+  return UINT2NUM(get_ImageLoader(self)->loader.requested());
+}
+
+SWIGINTERN VALUE _wrap_ImageLoader_finished(VALUE self) {
+  return UINT2NUM(get_ImageLoader(self)->loader.finished());
+}
+
+SWIGINTERN VALUE _wrap_ImageLoader_doneq___(VALUE self) {
+  const Gosu::ImageLoader& loader = get_ImageLoader(self)->loader;
+  return loader.finished() == loader.requested() ? Qtrue : Qfalse;
+}
+
+SWIGINTERN VALUE _wrap_set_image_cache_directory(VALUE self, VALUE directory) {
+  Gosu::set_image_cache_directory(NIL_P(directory) ? "" : StringValueCStr(directory));
+  return directory;
+}
+
 SWIGINTERN VALUE
 _wrap_fps(int argc, VALUE *argv, VALUE self) {
   int result;
@@ -8632,6 +8858,55 @@ fail:
   return Qnil;
 }
 
+SWIGINTERN VALUE _wrap_Window_start_recording(VALUE self, VALUE filename)
+{
+  Gosu::Window *arg1 = (Gosu::Window *) 0;
+  void *argp1 = 0;
+  int res1 = SWIG_ConvertPtr(self, &argp1, SWIGTYPE_p_Gosu__Window, 0 | 0);
+  if (!SWIG_IsOK(res1))
+    SWIG_exception_fail(SWIG_ArgError(res1), Ruby_Format_TypeError("", "Gosu::Window", "start_recording", 1, self));
+  arg1 = reinterpret_cast< Gosu::Window * >(argp1);
+  try {
+    (arg1)->start_recording(StringValueCStr(filename));
+  } catch (const std::exception& e) {
+    SWIG_exception(SWIG_RuntimeError, e.what());
+  }
+  return Qnil;
+fail:
+  return Qnil;
+}
+
+SWIGINTERN VALUE _wrap_Window_stop_recording(VALUE self)
+{
+  Gosu::Window *arg1 = (Gosu::Window *) 0;
+  void *argp1 = 0;
+  int res1 = SWIG_ConvertPtr(self, &argp1, SWIGTYPE_p_Gosu__Window, 0 | 0);
+  if (!SWIG_IsOK(res1))
+    SWIG_exception_fail(SWIG_ArgError(res1), Ruby_Format_TypeError("", "Gosu::Window", "stop_recording", 1, self));
+  arg1 = reinterpret_cast< Gosu::Window * >(argp1);
+  try {
+    (arg1)->stop_recording();
+  } catch (const std::exception& e) {
+    SWIG_exception(SWIG_RuntimeError, e.what());
+  }
+  return Qnil;
+fail:
+  return Qnil;
+}
+
+SWIGINTERN VALUE _wrap_Window_recordingq___(VALUE self)
+{
+  Gosu::Window *arg1 = (Gosu::Window *) 0;
+  void *argp1 = 0;
+  int res1 = SWIG_ConvertPtr(self, &argp1, SWIGTYPE_p_Gosu__Window, 0 | 0);
+  if (!SWIG_IsOK(res1))
+    SWIG_exception_fail(SWIG_ArgError(res1), Ruby_Format_TypeError("", "Gosu::Window const *", "recording?", 1, self));
+  arg1 = reinterpret_cast< Gosu::Window * >(argp1);
+  return (arg1)->recording() ? Qtrue : Qfalse;
+fail:
+  return Qnil;
+}
+
 SWIGINTERN VALUE _wrap_Window_show(VALUE self) {
   Gosu::Window *arg1 = (Gosu::Window *) 0;
   void *argp1 = 0;
@@ -11362,9 +11637,14 @@ SWIGEXPORT void Init_gosu_kustom(void) {
   rb_define_module_function(mGosu, "normalize_angle", VALUEFUNC(_wrap_normalize_angle), -1);
   rb_define_module_function(mGosu, "distance", VALUEFUNC(_wrap_distance), -1);
   rb_define_module_function(mGosu, "default_font_name", VALUEFUNC(_wrap_default_font_name), -1);
-  rb_define_const(mGosu, "MAX_TEXTURE_SIZE", SWIG_From_unsigned_SS_int(static_cast< unsigned int >(Gosu::MAX_TEXTURE_SIZE)));
+  // Deprecated, kept for old scripts. Gosu.texture_size is the size that is actually used.
+  rb_define_const(mGosu, "MAX_TEXTURE_SIZE", SWIG_From_unsigned_SS_int(1024u));
   rb_define_module_function(mGosu, "language", VALUEFUNC(_wrap_language), -1);
   rb_define_module_function(mGosu, "enable_undocumented_retrofication", VALUEFUNC(_wrap_enable_undocumented_retrofication), 0);
+  rb_define_module_function(mGosu, "texture_size", VALUEFUNC(_wrap_texture_size), 0);
+  rb_define_module_function(mGosu, "max_texture_size=", VALUEFUNC(_wrap_set_max_texture_size), 1);
+  rb_define_module_function(mGosu, "premultiplied_alpha", VALUEFUNC(_wrap_premultiplied_alpha), 0);
+  rb_define_module_function(mGosu, "premultiplied_alpha=", VALUEFUNC(_wrap_set_premultiplied_alpha), 1);
   rb_define_module_function(mGosu, "_release_all_openal_resources", VALUEFUNC(_wrap__release_all_openal_resources), 0);
   
   SwigClassGLTexInfo.klass = rb_define_class_under(mGosu, "GLTexInfo", rb_cObject);
@@ -11405,10 +11685,23 @@ SWIGEXPORT void Init_gosu_kustom(void) {
   rb_define_method(SwigClassImage.klass, "save", VALUEFUNC(_wrap_Image_save), 1);
   rb_define_method(SwigClassImage.klass, "insert", VALUEFUNC(_wrap_Image_insert), -1);
   rb_define_method(SwigClassImage.klass, "inspect", VALUEFUNC(_wrap_Image_inspect), -1);
+  rb_define_method(SwigClassImage.klass, "prefetch", VALUEFUNC(_wrap_Image_prefetch), 0);
   SwigClassImage.mark = 0;
   SwigClassImage.destroy = (void (*)(void *)) free_Gosu_Image;
   SwigClassImage.trackObjects = 1;
+  
+  VALUE cImageLoader = rb_define_class_under(mGosu, "ImageLoader", rb_cObject);
+  rb_define_alloc_func(cImageLoader, _wrap_ImageLoader_allocate);
+  rb_define_method(cImageLoader, "load", VALUEFUNC(_wrap_ImageLoader_load), -1);
+  rb_define_method(cImageLoader, "[]", VALUEFUNC(_wrap_ImageLoader_get), 1);
+  rb_define_method(cImageLoader, "update", VALUEFUNC(_wrap_ImageLoader_update), -1);
+  rb_define_method(cImageLoader, "wait", VALUEFUNC(_wrap_ImageLoader_wait), 0);
+  rb_define_method(cImageLoader, "progress", VALUEFUNC(_wrap_ImageLoader_progress), 0);
+  rb_define_method(cImageLoader, "requested", VALUEFUNC(_wrap_ImageLoader_requested), 0);
+  rb_define_method(cImageLoader, "finished", VALUEFUNC(_wrap_ImageLoader_finished), 0);
+  rb_define_method(cImageLoader, "done?", VALUEFUNC(_wrap_ImageLoader_doneq___), 0);
   rb_define_module_function(mGosu, "fps", VALUEFUNC(_wrap_fps), -1);
+  rb_define_module_function(mGosu, "image_cache_directory=", VALUEFUNC(_wrap_set_image_cache_directory), 1);
   
   SwigClassChannel.klass = rb_define_class_under(mGosu, "Channel", rb_cObject);
   SWIG_TypeClientData(SWIGTYPE_p_Gosu__Channel, (void *) &SwigClassChannel);
@@ -11498,6 +11791,9 @@ SWIGEXPORT void Init_gosu_kustom(void) {
   rb_define_method(SwigClassWindow.klass, "caption", VALUEFUNC(_wrap_Window_caption), 0);
   rb_define_method(SwigClassWindow.klass, "caption=", VALUEFUNC(_wrap_Window_captione___), 1);
   rb_define_method(SwigClassWindow.klass, "save_screenshot", VALUEFUNC(_wrap_Window_save_screenshot), 1);
+  rb_define_method(SwigClassWindow.klass, "start_recording", VALUEFUNC(_wrap_Window_start_recording), 1);
+  rb_define_method(SwigClassWindow.klass, "stop_recording", VALUEFUNC(_wrap_Window_stop_recording), 0);
+  rb_define_method(SwigClassWindow.klass, "recording?", VALUEFUNC(_wrap_Window_recordingq___), 0);
   rb_define_method(SwigClassWindow.klass, "show", VALUEFUNC(_wrap_Window_show), 0);
   rb_define_method(SwigClassWindow.klass, "tick", VALUEFUNC(_wrap_Window_tick), -1);
   rb_define_method(SwigClassWindow.klass, "close", VALUEFUNC(_wrap_Window_close), -1);
@@ -0,0 +1,145 @@
+#include "StreamingImage.hpp"
+#include "Graphics.hpp"
+#include "GraphicsImpl.hpp"
+#include "Image.hpp"
+#include "TexChunk.hpp"
+#include "Texture.hpp"
+#include <stdexcept>
+using namespace std;
+
+struct Gosu::StreamingImage::Impl
+{
+  // Frames are written into these buffers in turn, so that the CPU never has to wait for the
+  // upload of the previous frame.
+  static const unsigned BUFFER_COUNT = 3;
+
+  shared_ptr<Texture> texture;
+  Image image;
+  bool locked = false;
+  // Pixel buffer objects, or zero if frames go through a bitmap instead.
+  GLuint buffers[BUFFER_COUNT] = {};
+  unsigned next_buffer = 0;
+  Bitmap frame;
+};
+
+Gosu::StreamingImage::StreamingImage(unsigned width, unsigned height, unsigned image_flags)
+: pimpl(new Impl)
+{
+  if (width == 0 || height == 0)
+    throw invalid_argument("StreamingImage must not be empty");
+
+  ensure_current_context();
+  GLint max_size;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+  if (width > static_cast<unsigned>(max_size) || height > static_cast<unsigned>(max_size))
+    throw invalid_argument("StreamingImage must fit onto a single texture");
+
+  // A texture of exactly this size, so that frames never need atlas space and can be uploaded in
+  // one piece. Its edges are clamped, which is why there is no padding.
+  pimpl->texture = make_shared<Texture>(width, height, 1, 0, image_flags & IF_RETRO);
+  pimpl->texture->block(0, 0, width, height);
+  pimpl->image = Image(unique_ptr<ImageData>(new TexChunk(pimpl->texture, 0, 0, width, height, 0,
+                                                          false)));
+
+#ifndef GOSU_IS_OPENGLES
+  // Pixel buffers are uploaded as they are, so premultiplied alpha needs the bitmap, which goes
+  // through Texture's conversion.
+  static bool has_pixel_buffers = SDL_GL_ExtensionSupported("GL_ARB_pixel_buffer_object");
+  if (has_pixel_buffers && !Graphics::premultiplied_alpha()) {
+    GOSU_LOAD_GL_EXT(glGenBuffers, PFNGLGENBUFFERSPROC);
+    glGenBuffers(Impl::BUFFER_COUNT, pimpl->buffers);
+    return;
+  }
+#endif
+  pimpl->frame = Bitmap(width, height);
+}
+
+Gosu::StreamingImage::~StreamingImage()
+{
+#ifndef GOSU_IS_OPENGLES
+  if (pimpl->buffers[0] != 0) {
+    try {
+      GOSU_LOAD_GL_EXT(glDeleteBuffers, PFNGLDELETEBUFFERSPROC);
+      ensure_current_context();
+      // This also unmaps a buffer that is still locked.
+      glDeleteBuffers(Impl::BUFFER_COUNT, pimpl->buffers);
+    } catch (...) {
+      // The function was loaded when the buffers were created, so this cannot happen.
+    }
+  }
+#endif
+}
+
+unsigned Gosu::StreamingImage::width() const
+{
+  return pimpl->image.width();
+}
+
+unsigned Gosu::StreamingImage::height() const
+{
+  return pimpl->image.height();
+}
+
+Gosu::Color* Gosu::StreamingImage::lock()
+{
+  if (pimpl->locked)
+    throw logic_error("StreamingImage is already locked");
+
+#ifndef GOSU_IS_OPENGLES
+  if (pimpl->buffers[0] != 0) {
+    GOSU_LOAD_GL_EXT(glBindBuffer, PFNGLBINDBUFFERPROC);
+    GOSU_LOAD_GL_EXT(glBufferData, PFNGLBUFFERDATAPROC);
+    GOSU_LOAD_GL_EXT(glMapBuffer, PFNGLMAPBUFFERPROC);
+
+    ensure_current_context();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pimpl->buffers[pimpl->next_buffer]);
+    // Orphan the old contents, so that mapping does not wait for an upload that reads them.
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, width() * height() * sizeof(Color), nullptr,
+                 GL_STREAM_DRAW);
+    void* pixels = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (!pixels)
+      throw runtime_error("Could not map pixel buffer for StreamingImage");
+    pimpl->locked = true;
+    return static_cast<Color*>(pixels);
+  }
+#endif
+  pimpl->locked = true;
+  return pimpl->frame.data();
+}
+
+void Gosu::StreamingImage::unlock()
+{
+  if (!pimpl->locked)
+    throw logic_error("StreamingImage is not locked");
+  pimpl->locked = false;
+
+#ifndef GOSU_IS_OPENGLES
+  if (pimpl->buffers[0] != 0) {
+    GOSU_LOAD_GL_EXT(glBindBuffer, PFNGLBINDBUFFERPROC);
+    GOSU_LOAD_GL_EXT(glUnmapBuffer, PFNGLUNMAPBUFFERPROC);
+
+    ensure_current_context();
+    // The upload below bypasses the texture's shadow copy (see Texture::replace), which would
+    // be stale afterwards. This uploads from client memory, so no unpack buffer may be bound.
+    pimpl->texture->release_shadow();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pimpl->buffers[pimpl->next_buffer]);
+    // If the buffer's contents were lost (e.g. by a mode switch), keep showing the old frame.
+    if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+      // With an unpack buffer bound, this copies from the buffer without involving the CPU.
+      glBindTexture(GL_TEXTURE_2D, pimpl->texture->tex_name());
+      glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width(), height(), Color::GL_FORMAT,
+                      GL_UNSIGNED_BYTE, nullptr);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    pimpl->next_buffer = (pimpl->next_buffer + 1) % Impl::BUFFER_COUNT;
+    return;
+  }
+#endif
+  pimpl->texture->replace(pimpl->frame, 0, 0, 0, 0, width(), height());
+}
+
+const Gosu::Image& Gosu::StreamingImage::image() const
+{
+  return pimpl->image;
+}
@@ -3,6 +3,8 @@
 #include "Texture.hpp"
 #include "Bitmap.hpp"
 #include "Graphics.hpp"
+#include "Math.hpp"
+#include <algorithm>
 #include <stdexcept>
 
 using namespace std;
@@ -17,14 +19,17 @@ void Gosu::TexChunk::set_tex_info()
   info.bottom = (y + h) / height;
 }
 
-Gosu::TexChunk::TexChunk(shared_ptr<Texture> texture, int x, int y, int w, int h, int padding)
-: texture(move(texture)), x(x), y(y), w(w), h(h), padding(padding)
+Gosu::TexChunk::TexChunk(shared_ptr<Texture> texture, int x, int y, int w, int h, int padding,
+                         bool retro)
+: texture(move(texture)), x(x), y(y), w(w), h(h), padding(padding), retro(retro),
+  offset_x(0), offset_y(0), full_w(w), full_h(h)
 {
   set_tex_info();
 }
 
 Gosu::TexChunk::TexChunk(const TexChunk& parent, int x, int y, int w, int h)
-: texture(parent.texture), x(parent.x + x), y(parent.y + y), w(w), h(h), padding(0)
+: texture(parent.texture), x(parent.x + x), y(parent.y + y), w(w), h(h), padding(0),
+  retro(parent.retro), offset_x(0), offset_y(0), full_w(w), full_h(h)
 {
   if (x < 0 || y < 0 || x + w > parent.w || y + h > parent.h)
     throw invalid_argument("subimage bounds exceed those of its parent");
@@ -39,12 +44,121 @@ Gosu::TexChunk::~TexChunk()
   texture->free(x - padding, y - padding, w + 2 * padding, h + 2 * padding);
 }
 
+void Gosu::TexChunk::set_trim(int offset_x, int offset_y, int full_w, int full_h)
+{
+  this->offset_x = offset_x;
+  this->offset_y = offset_y;
+  this->full_w = full_w;
+  this->full_h = full_h;
+}
+
+void Gosu::TexChunk::build_mesh(const BitmapView& bmp, unsigned src_x, unsigned src_y)
+{
+  mesh.clear();
+  // Horizontal extent of the visible pixels in each row. Empty rows have left >= right.
+  vector<int> lefts(h, w), rights(h, 0);
+  for (int row = 0; row < h; ++row) {
+    for (int col = 0; col < w; ++col) {
+      if (bmp.get_pixel(src_x + col, src_y + row).alpha() == 0) continue;
+      lefts[row] = min(lefts[row], col);
+      rights[row] = col + 1;
+    }
+  }
+  // Grow each row's extent by one pixel in every direction, so that linear filtering can still
+  // fade the edges out into the transparent surroundings.
+  vector<int> grown_lefts(h, w), grown_rights(h, 0);
+  for (int row = 0; row < h; ++row) {
+    for (int i = max(row - 1, 0); i <= min(row + 1, h - 1); ++i) {
+      if (lefts[i] >= rights[i]) continue;
+      grown_lefts[row] = min(grown_lefts[row], max(lefts[i] - 1, 0));
+      grown_rights[row] = max(grown_rights[row], min(rights[i] + 1, w));
+    }
+  }
+  // Cut the chunk into a few horizontal bands that do not overlap, and cover each band with the
+  // bounding box of its rows.
+  const int MAX_BANDS = 8;
+  int band_height = (h + MAX_BANDS - 1) / MAX_BANDS;
+  long area = 0;
+  for (int band_top = 0; band_top < h; band_top += band_height) {
+    Part part = { w, h, 0, 0 };
+    for (int row = band_top; row < min(band_top + band_height, h); ++row) {
+      if (grown_lefts[row] >= grown_rights[row]) continue;
+      part.left   = min(part.left, grown_lefts[row]);
+      part.right  = max(part.right, grown_rights[row]);
+      part.top    = min(part.top, row);
+      part.bottom = row + 1;
+    }
+    if (part.left >= part.right) continue;
+    // Merge with the band above if it continues it seamlessly.
+    if (!mesh.empty() && mesh.back().bottom == part.top &&
+        mesh.back().left == part.left && mesh.back().right == part.right) {
+      mesh.back().bottom = part.bottom;
+    }
+    else {
+      mesh.push_back(part);
+    }
+    area += long(part.right - part.left) * (part.bottom - part.top);
+  }
+  // Not worth the additional vertices unless a good part of the chunk is left out.
+  if (area * 4 > long(w) * h * 3) mesh.clear();
+}
+
 void Gosu::TexChunk::draw(double x1, double y1, Color c1, double x2, double y2, Color c2,
     double x3, double y3, Color c3, double x4, double y4, Color c4, ZPos z, AlphaMode mode) const
+{
+  draw(x1, y1, c1, x2, y2, c2, x3, y3, c3, x4, y4, c4, z, mode, NO_PALETTE);
+}
+
+void Gosu::TexChunk::draw(double x1, double y1, Color c1, double x2, double y2, Color c2,
+    double x3, double y3, Color c3, double x4, double y4, Color c4, ZPos z, AlphaMode mode,
+    int palette) const
+{
+  if (!trimmed() && mesh.empty()) {
+    draw_quad(info.left, info.top, info.right, info.bottom,
+              x1, y1, c1, x2, y2, c2, x3, y3, c3, x4, y4, c4, z, mode, palette);
+    return;
+  }
+  // The given corners belong to the full image; map each stored rectangle into that quad.
+  auto point = [&](double u, double v, double& x, double& y, Color& c) {
+    double top_x = interpolate(x1, x2, u), bottom_x = interpolate(x3, x4, u);
+    double top_y = interpolate(y1, y2, u), bottom_y = interpolate(y3, y4, u);
+    x = interpolate(top_x, bottom_x, v);
+    y = interpolate(top_y, bottom_y, v);
+    c = interpolate(interpolate(c1, c2, u), interpolate(c3, c4, u), v);
+  };
+  double tex_width = texture->width(), tex_height = texture->height();
+  auto draw_part = [&](int left, int top, int right, int bottom) {
+    double u1 = double(offset_x + left) / full_w, u2 = double(offset_x + right) / full_w;
+    double v1 = double(offset_y + top) / full_h,  v2 = double(offset_y + bottom) / full_h;
+    double px1, py1, px2, py2, px3, py3, px4, py4;
+    Color pc1, pc2, pc3, pc4;
+    point(u1, v1, px1, py1, pc1);
+    point(u2, v1, px2, py2, pc2);
+    point(u1, v2, px3, py3, pc3);
+    point(u2, v2, px4, py4, pc4);
+    draw_quad((x + left) / tex_width, (y + top) / tex_height,
+              (x + right) / tex_width, (y + bottom) / tex_height,
+              px1, py1, pc1, px2, py2, pc2, px3, py3, pc3, px4, py4, pc4, z, mode, palette);
+  };
+  if (mesh.empty()) {
+    draw_part(0, 0, w, h);
+  }
+  else {
+    for (const auto& part : mesh)
+      draw_part(part.left, part.top, part.right, part.bottom);
+  }
+}
+
+void Gosu::TexChunk::draw_quad(double left, double top, double right, double bottom,
+    double x1, double y1, Color c1, double x2, double y2, Color c2,
+    double x3, double y3, Color c3, double x4, double y4, Color c4, ZPos z, AlphaMode mode,
+    int palette) const
 {
   DrawOp op;
   op.render_state.texture = texture;
+  op.render_state.palette = palette;
   op.render_state.mode = mode;
+  op.retro = retro;
   normalize_coordinates(x1, y1, x2, y2, x3, y3, c3, x4, y4, c4);
   op.vertices_or_block_index = 4;
   op.vertices[0] = DrawOp::Vertex(x1, y1, c1);
@@ -57,51 +171,106 @@ void Gosu::TexChunk::draw(double x1, double y1, Color c1, double x2, double y2,
   op.vertices[3] = DrawOp::Vertex(x3, y3, c3);
   op.vertices[2] = DrawOp::Vertex(x4, y4, c4);
 #endif
-  op.left = info.left;
-  op.top = info.top;
-  op.right = info.right;
-  op.bottom = info.bottom;
+  op.left = left;
+  op.top = top;
+  op.right = right;
+  op.bottom = bottom;
   op.z = z;
   Graphics::schedule_draw_op(op);
 }
 
 unique_ptr<Gosu::ImageData> Gosu::TexChunk::subimage(int x, int y, int width, int height) const
 {
-  return unique_ptr<Gosu::ImageData>(new TexChunk(*this, x, y, width, height));
+  if (!trimmed()) return unique_ptr<Gosu::ImageData>(new TexChunk(*this, x, y, width, height));
+  if (x < 0 || y < 0 || x + width > full_w || y + height > full_h)
+    throw invalid_argument("subimage bounds exceed those of its parent");
+  if (width <= 0 || height <= 0)
+    throw invalid_argument("cannot create empty image");
+  // Only the part that overlaps the stored rectangle needs texture space.
+  int left   = max(x, offset_x),              top    = max(y, offset_y);
+  int right  = min(x + width, offset_x + w),  bottom = min(y + height, offset_y + h);
+  if (left >= right || top >= bottom) {
+    // Nothing visible: Trimming leaves a single transparent pixel, which must go onto the same
+    // kind of texture as its parent.
+    unsigned flags = IF_TRIM | texture->format();
+    if (texture->retro() || retro) flags |= IF_RETRO;
+    if (texture->mip_levels() > 1) flags |= IF_MIPMAP;
+    Bitmap empty(width, height);
+    return Graphics::create_image(empty, 0, 0, width, height, flags);
+  }
+  unique_ptr<TexChunk> result(new TexChunk(*this, left - offset_x, top - offset_y,
+                                           right - left, bottom - top));
+  result->set_trim(left - x, top - y, width, height);
+  return result;
 }
 
 Gosu::Bitmap Gosu::TexChunk::to_bitmap() const
 {
-  return texture->to_bitmap(x, y, w, h);
+  if (!trimmed()) return texture->to_bitmap(x, y, w, h);
+  Bitmap result(full_w, full_h);
+  result.insert(texture->to_bitmap(x, y, w, h), offset_x, offset_y);
+  return result;
 }
 
-void Gosu::TexChunk::insert(const Bitmap& original, int x, int y)
+const Gosu::GLTexInfo* Gosu::TexChunk::gl_tex_info() const
 {
-  Bitmap alternate;
-  const Bitmap* bitmap = &original;
-  if (x < 0 || y < 0 || x + original.width() > w || y + original.height() > h) {
-    int offset_x = 0, offset_y = 0;
-    int trimmed_width = original.width(), trimmed_height = original.height();
-    if (x < 0) {
-      offset_x = x;
-      trimmed_width += x;
-      x = 0;
-    }
-    if (y < 0) {
-      offset_y = y;
-      trimmed_height += y;
-      y = 0;
+  if (trimmed()) return nullptr;
+  // The caller is about to draw the texture with its own OpenGL code.
+  texture->flush();
+  return &info;
+}
+
+future<Gosu::Bitmap> Gosu::TexChunk::to_bitmap_async() const
+{
+  if (!trimmed()) return texture->to_bitmap_async(x, y, w, h);
+  auto stored = make_shared<future<Bitmap>>(texture->to_bitmap_async(x, y, w, h));
+  int offset_x = this->offset_x, offset_y = this->offset_y;
+  int full_w = this->full_w, full_h = this->full_h;
+  return async(launch::deferred, [=] {
+    Bitmap result(full_w, full_h);
+    result.insert(stored->get(), offset_x, offset_y);
+    return result;
+  });
+}
+
+void Gosu::TexChunk::insert(const BitmapView& original, int x, int y)
+{
+  x -= offset_x;
+  y -= offset_y;
+  // The trimmed-away borders are not stored anywhere, so they must stay transparent.
+  if (trimmed()) {
+    for (int src_y = 0; src_y < (int) original.height(); ++src_y) {
+      int image_y = y + src_y + offset_y;
+      if (image_y < 0 || image_y >= full_h) continue;
+      for (int src_x = 0; src_x < (int) original.width(); ++src_x) {
+        int image_x = x + src_x + offset_x;
+        if (image_x < 0 || image_x >= full_w) continue;
+        bool stored = (x + src_x >= 0 && x + src_x < w && y + src_y >= 0 && y + src_y < h);
+        if (!stored && original.get_pixel(src_x, src_y).alpha() != 0)
+          throw invalid_argument("Cannot insert visible pixels into the trimmed borders of an "
+                                 "image created with IF_TRIM");
+      }
     }
-    if (x + trimmed_width > w)
-      trimmed_width -= (w - x - trimmed_width);
-    if (y + trimmed_height > h)
-      trimmed_height -= (h - y - trimmed_height);
-    if (trimmed_width <= 0 || trimmed_height <= 0) return;
-    alternate.resize(trimmed_width, trimmed_height);
-    alternate.insert(original, offset_x, offset_y);
-    bitmap = &alternate;
   }
-  glBindTexture(GL_TEXTURE_2D, tex_name());
-  glTexSubImage2D(GL_TEXTURE_2D, 0, this->x + x, this->y + y, bitmap->width(), bitmap->height(),
-      Color::GL_FORMAT, GL_UNSIGNED_BYTE, bitmap->data());
+  // The mesh may not cover the new pixels anymore, so it is dropped.
+  mesh.clear();
+  // Clip the bitmap to the stored rectangle without copying it.
+  unsigned src_x = 0, src_y = 0;
+  int width = original.width(), height = original.height();
+  if (x < 0) {
+    src_x = -x;
+    width += x;
+    x = 0;
+  }
+  if (y < 0) {
+    src_y = -y;
+    height += y;
+    y = 0;
+  }
+  if (x + width > w)
+    width = w - x;
+  if (y + height > h)
+    height = h - y;
+  if (width <= 0 || height <= 0) return;
+  texture->replace(original, src_x, src_y, this->x + x, this->y + y, width, height);
 }
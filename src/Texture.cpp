@@ -4,18 +4,129 @@
 #include "Bitmap.hpp"
 #include "Graphics.hpp"
 #include "Platform.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <stdexcept>
 using namespace std;
 
 namespace Gosu
 {
   bool undocumented_retrofication = false;
+
+  namespace
+  {
+    // Halves both dimensions by averaging 2x2 pixels. Colors are weighted by their alpha, so that
+    // transparent pixels do not darken the edges of an image.
+    Bitmap half_size(const Bitmap& bmp)
+    {
+      Bitmap result(bmp.width() / 2, bmp.height() / 2);
+      for (unsigned y = 0; y < result.height(); ++y) {
+        for (unsigned x = 0; x < result.width(); ++x) {
+          unsigned alpha = 0, red = 0, green = 0, blue = 0;
+          for (unsigned i = 0; i < 4; ++i) {
+            Color c = bmp.get_pixel(x * 2 + i % 2, y * 2 + i / 2);
+            alpha += c.alpha();
+            red   += c.red()   * c.alpha();
+            green += c.green() * c.alpha();
+            blue  += c.blue()  * c.alpha();
+          }
+          if (alpha == 0) continue;
+          result.set_pixel(x, y, Color((alpha + 2) / 4, red / alpha, green / alpha, blue / alpha));
+        }
+      }
+      return result;
+    }
+
+    // Describes how pixels are stored in a texture of the given format.
+    struct StorageFormat
+    {
+      GLint internal_format;
+      GLenum format, type;
+      unsigned bytes_per_pixel;
+    };
+
+    StorageFormat storage_format(unsigned format)
+    {
+#ifdef GOSU_IS_OPENGLES
+      // OpenGL ES 1 only accepts unsized internal formats, which must match the pixel format.
+      if (format & IF_ALPHA8)    return { GL_ALPHA, GL_ALPHA, GL_UNSIGNED_BYTE, 1 };
+      if (format & IF_RGB565)    return { GL_RGB, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 2 };
+      if (format & IF_RGBA4444)  return { GL_RGBA, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, 2 };
+      return { GL_RGBA, GL_RGBA, GL_UNSIGNED_BYTE, 4 };
+#else
+      // Request sized internal formats. With unsized ones, the driver may store all of these at
+      // 8 bits per channel, and nothing would be saved.
+      // With premultiplied alpha, the color channels must be scaled by coverage as well.
+      if ((format & IF_ALPHA8) && Graphics::premultiplied_alpha())
+        return { GL_INTENSITY8, GL_ALPHA, GL_UNSIGNED_BYTE, 1 };
+      if (format & IF_ALPHA8)    return { GL_ALPHA8, GL_ALPHA, GL_UNSIGNED_BYTE, 1 };
+#ifdef GL_RGB565
+      if (format & IF_RGB565)    return { GL_RGB565, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 2 };
+#else
+      // GL_RGB565 is only defined since OpenGL 4.1; GL_RGB5 is the closest older format.
+      if (format & IF_RGB565)    return { GL_RGB5, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 2 };
+#endif
+      if (format & IF_RGBA4444)  return { GL_RGBA4, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, 2 };
+      return { 4, GL_RGBA, GL_UNSIGNED_BYTE, 4 };
+#endif
+    }
+
+    // Conversion kernels from a row of Colors into the packed layouts above.
+    void convert_row(unsigned format, const Color* src, unsigned width, void* dest)
+    {
+      if (format & IF_ALPHA8) {
+        auto out = static_cast<std::uint8_t*>(dest);
+        for (unsigned x = 0; x < width; ++x)
+          out[x] = src[x].alpha();
+      }
+      else if (format & IF_RGB565) {
+        auto out = static_cast<std::uint16_t*>(dest);
+        for (unsigned x = 0; x < width; ++x)
+          out[x] = (src[x].red() >> 3) << 11 | (src[x].green() >> 2) << 5 | src[x].blue() >> 3;
+      }
+      else {
+        auto out = static_cast<std::uint16_t*>(dest);
+        for (unsigned x = 0; x < width; ++x)
+          out[x] = (src[x].red() >> 4) << 12 | (src[x].green() >> 4) << 8 |
+                   (src[x].blue() >> 4) << 4 | src[x].alpha() >> 4;
+      }
+    }
+
+#ifndef GOSU_IS_OPENGLES
+    // Owns a pixel buffer object, so that it is deleted even if nobody waits for the readback
+    // that it was created for. Must be destroyed on the rendering thread.
+    struct PixelPackBuffer
+    {
+      GLuint name;
+
+      explicit PixelPackBuffer(GLuint name) : name(name) {}
+      PixelPackBuffer(const PixelPackBuffer&) = delete;
+      PixelPackBuffer& operator=(const PixelPackBuffer&) = delete;
+
+      ~PixelPackBuffer()
+      {
+        ensure_current_context();
+        try {
+          GOSU_LOAD_GL_EXT(glDeleteBuffers, PFNGLDELETEBUFFERSPROC);
+          glDeleteBuffers(1, &name);
+        } catch (...) {
+          // The function was loaded when the buffer was created, so this cannot happen.
+        }
+      }
+    };
+#endif
+  }
 }
 
-Gosu::Texture::Texture(unsigned width, unsigned height, bool retro)
-: allocator_(width, height), retro_(retro)
+Gosu::Texture::Texture(unsigned width, unsigned height, unsigned mip_levels, unsigned format,
+    bool retro)
+: allocator_(width >> (mip_levels - 1), height >> (mip_levels - 1)), mip_levels_(mip_levels),
+  format_(format & FORMAT_FLAGS), retro_(retro), has_retro_images_(false),
+  framebuffer_(0)
 {
-  log("Allocating a new texture of size %dx%d (retro=%d)", width, height, (int) retro);
+  log("Allocating a new texture of size %dx%d (mip_levels=%d, format=%x, retro=%d)",
+      width, height, mip_levels, format_, (int) retro);
   ensure_current_context();
   // Create texture name.
   glGenTextures(1, &tex_name_);
@@ -23,18 +134,22 @@ Gosu::Texture::Texture(unsigned width, unsigned height, bool retro)
     throw runtime_error("Couldn't create OpenGL texture");
   // Create empty texture.
   glBindTexture(GL_TEXTURE_2D, tex_name_);
-#ifdef GOSU_IS_OPENGLES
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, allocator_.width(), allocator_.height(), 0, GL_RGBA,
-     GL_UNSIGNED_BYTE, nullptr);
-#else
-  glTexImage2D(GL_TEXTURE_2D, 0, 4, allocator_.width(), allocator_.height(), 0, GL_RGBA,
-     GL_UNSIGNED_BYTE, nullptr);
-#endif
+  StorageFormat storage = storage_format(format_);
+  for (unsigned level = 0; level < mip_levels; ++level) {
+    glTexImage2D(GL_TEXTURE_2D, level, storage.internal_format, width >> level, height >> level,
+       0, storage.format, storage.type, nullptr);
+  }
   if (retro || undocumented_retrofication) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   } else {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  }
+  if (mip_levels > 1) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+#ifdef GL_TEXTURE_MAX_LEVEL
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mip_levels - 1);
+#endif
+  } else {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   }
 #ifdef GL_CLAMP_TO_EDGE
@@ -49,17 +164,25 @@ Gosu::Texture::Texture(unsigned width, unsigned height, bool retro)
 Gosu::Texture::~Texture()
 {
   ensure_current_context();
+  if (framebuffer_ != 0) {
+    try {
+      GOSU_LOAD_GL_EXT(glDeleteFramebuffers, PFNGLDELETEFRAMEBUFFERSPROC);
+      glDeleteFramebuffers(1, &framebuffer_);
+    } catch (...) {
+      // The function was loaded when the framebuffer was created, so this cannot happen.
+    }
+  }
   glDeleteTextures(1, &tex_name_);
 }
 
 unsigned Gosu::Texture::width() const
 {
-  return allocator_.width();
+  return allocator_.width() * granularity();
 }
 
 unsigned Gosu::Texture::height() const
 {
-  return allocator_.height();
+  return allocator_.height() * granularity();
 }
 
 GLuint Gosu::Texture::tex_name() const
@@ -67,52 +190,454 @@ GLuint Gosu::Texture::tex_name() const
   return tex_name_;
 }
 
+unsigned Gosu::Texture::mip_levels() const
+{
+  return mip_levels_;
+}
+
+unsigned Gosu::Texture::format() const
+{
+  return format_;
+}
+
 bool Gosu::Texture::retro() const
 {
-    return retro_;
+  return retro_;
+}
+
+bool Gosu::Texture::has_retro_images() const
+{
+  return has_retro_images_;
+}
+
+bool Gosu::Texture::shares_retro_images(unsigned mip_levels, unsigned format)
+{
+  return mip_levels == 1 && (format & FORMAT_FLAGS) != IF_ALPHA8 && retro_program_available();
+}
+
+bool Gosu::Texture::marks_retro(unsigned image_flags)
+{
+  // On a retro texture, the filter already does the job.
+  if (!(image_flags & IF_RETRO) || retro_) return false;
+  has_retro_images_ = true;
+  return true;
 }
 
-unique_ptr<Gosu::TexChunk> Gosu::Texture::try_alloc(const Bitmap& bmp, unsigned padding)
+bool Gosu::Texture::alloc(unsigned width, unsigned height, BlockAllocator::Block& block)
+{
+  unsigned g = granularity();
+  if (!allocator_.alloc((width + g - 1) / g, (height + g - 1) / g, block)) return false;
+  block = BlockAllocator::Block(block.left * g, block.top * g, block.width * g, block.height * g);
+  return true;
+}
+
+void Gosu::Texture::upload(const BitmapView& bmp, unsigned src_x, unsigned src_y,
+    unsigned x, unsigned y, unsigned width, unsigned height, int mip_level)
+{
+  // Keep the shadow copy valid everywhere; see replace().
+  if (mip_level == 0 && shadow_.width() != 0 && bmp.data() != shadow_.data())
+    shadow_.insert(bmp, x, y, src_x, src_y, width, height);
+  if (Graphics::premultiplied_alpha() && !(format_ & IF_ALPHA8)) {
+    Bitmap portion(width, height);
+    for (unsigned row = 0; row < height; ++row) {
+      for (unsigned column = 0; column < width; ++column) {
+        portion.set_pixel(column, row, premultiply(bmp.get_pixel(src_x + column, src_y + row)));
+      }
+    }
+    upload_straight(portion, 0, 0, x, y, width, height, mip_level);
+  }
+  else {
+    upload_straight(bmp, src_x, src_y, x, y, width, height, mip_level);
+  }
+}
+
+void Gosu::Texture::upload_straight(const BitmapView& bmp, unsigned src_x, unsigned src_y,
+    unsigned x, unsigned y, unsigned width, unsigned height, int mip_level)
+{
+  if (format_ != 0) {
+    // Convert the portion into the texture's format first; rows are packed tightly.
+    StorageFormat storage = storage_format(format_);
+    vector<uint8_t> pixels(width * height * storage.bytes_per_pixel);
+    for (unsigned row = 0; row < height; ++row) {
+      convert_row(format_, bmp.row(src_y + row) + src_x, width,
+                  pixels.data() + row * width * storage.bytes_per_pixel);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, mip_level, x, y, width, height, storage.format, storage.type,
+                    pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return;
+  }
+#ifdef GOSU_IS_OPENGLES
+  // OpenGL ES 1 has no GL_UNPACK_ROW_LENGTH, so portions whose rows are not adjacent in memory
+  // need to be copied.
+  if (width != bmp.stride() && height > 1) {
+    Bitmap portion(width, height);
+    portion.insert(bmp, 0, 0, src_x, src_y, width, height);
+    upload_straight(portion, 0, 0, x, y, width, height, mip_level);
+    return;
+  }
+  glTexSubImage2D(GL_TEXTURE_2D, mip_level, x, y, width, height, Color::GL_FORMAT,
+                  GL_UNSIGNED_BYTE, bmp.row(src_y) + src_x);
+#else
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, bmp.stride());
+  glPixelStorei(GL_UNPACK_SKIP_PIXELS, src_x);
+  glPixelStorei(GL_UNPACK_SKIP_ROWS, src_y);
+  glTexSubImage2D(GL_TEXTURE_2D, mip_level, x, y, width, height, Color::GL_FORMAT,
+                  GL_UNSIGNED_BYTE, bmp.data());
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+  glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+#endif
+}
+
+void Gosu::Texture::fill(Color c, unsigned x, unsigned y, unsigned width, unsigned height)
+{
+  upload(Bitmap(width, height, c), 0, 0, x, y, width, height);
+}
+
+void Gosu::Texture::upload_mipmaps(Bitmap level, unsigned x, unsigned y)
+{
+  for (unsigned i = 1; i < mip_levels_; ++i) {
+    level = half_size(level);
+    upload(level, 0, 0, x >> i, y >> i, level.width(), level.height(), i);
+  }
+}
+
+unique_ptr<Gosu::TexChunk> Gosu::Texture::try_alloc(const BitmapView& bmp, unsigned src_x,
+    unsigned src_y, unsigned src_width, unsigned src_height, unsigned padding,
+    unsigned image_flags)
 {
   BlockAllocator::Block block;
-  if (!allocator_.alloc(bmp.width(), bmp.height(), block)) return nullptr;
-  unique_ptr<TexChunk> result(new TexChunk(shared_from_this(),
-                                           block.left   + padding,
-                                           block.top    + padding,
-                                           block.width  - 2 * padding,
-                                           block.height - 2 * padding,
-                                           padding));
+  if (!alloc(src_width + 2 * padding, src_height + 2 * padding, block)) return nullptr;
+  unsigned left = block.left + padding, top = block.top + padding;
+  unique_ptr<TexChunk> result(new TexChunk(shared_from_this(), left, top,
+                                           src_width, src_height, padding,
+                                           marks_retro(image_flags)));
+  unsigned src_right = src_x + src_width - 1, src_bottom = src_y + src_height - 1;
+  bool tileable_left   = (image_flags & IF_TILEABLE_LEFT);
+  bool tileable_top    = (image_flags & IF_TILEABLE_TOP);
+  bool tileable_right  = (image_flags & IF_TILEABLE_RIGHT);
+  bool tileable_bottom = (image_flags & IF_TILEABLE_BOTTOM);
   ensure_current_context();
   glBindTexture(GL_TEXTURE_2D, tex_name_);
-  glTexSubImage2D(GL_TEXTURE_2D, 0, block.left, block.top, block.width, block.height,
-                  Color::GL_FORMAT, GL_UNSIGNED_BYTE, bmp.data());
+  if (mip_levels_ > 1) {
+    // Build the whole block in memory, so that the smaller levels can be derived from it. The
+    // padding and the rounding at the right and bottom repeat the edges where they are
+    // tileable and are transparent otherwise.
+    Bitmap level(block.width, block.height);
+    for (unsigned y = 0; y < block.height; ++y) {
+      int row = int(y) - int(padding);
+      if (row < 0 && !tileable_top) continue;
+      if (row >= int(src_height) && !tileable_bottom) continue;
+      unsigned bmp_y = src_y + min<int>(max(row, 0), src_height - 1);
+      for (unsigned x = 0; x < block.width; ++x) {
+        int column = int(x) - int(padding);
+        if (column < 0 && !tileable_left) continue;
+        if (column >= int(src_width) && !tileable_right) continue;
+        unsigned bmp_x = src_x + min<int>(max(column, 0), src_width - 1);
+        level.set_pixel(x, y, bmp.get_pixel(bmp_x, bmp_y));
+      }
+    }
+    upload(level, 0, 0, block.left, block.top, block.width, block.height);
+    upload_mipmaps(move(level), block.left, block.top);
+    return result;
+  }
+  upload(bmp, src_x, src_y, left, top, src_width, src_height);
+  if (padding == 0) return result;
+  // The borders are made "harder" by duplicating the portion's edges, one thin upload at a time.
+  unsigned right = left + src_width, bottom = top + src_height;
+  // Top, including the corners.
+  if (tileable_top) {
+    for (unsigned i = 0; i < padding; ++i)
+      upload(bmp, src_x, src_y, left, block.top + i, src_width, 1);
+    fill(tileable_left ? bmp.get_pixel(src_x, src_y) : Color::NONE,
+         block.left, block.top, padding, padding);
+    fill(tileable_right ? bmp.get_pixel(src_right, src_y) : Color::NONE,
+         right, block.top, padding, padding);
+  } else {
+    fill(Color::NONE, block.left, block.top, block.width, padding);
+  }
+  // Bottom, including the corners.
+  if (tileable_bottom) {
+    for (unsigned i = 0; i < padding; ++i)
+      upload(bmp, src_x, src_bottom, left, bottom + i, src_width, 1);
+    fill(tileable_left ? bmp.get_pixel(src_x, src_bottom) : Color::NONE,
+         block.left, bottom, padding, padding);
+    fill(tileable_right ? bmp.get_pixel(src_right, src_bottom) : Color::NONE,
+         right, bottom, padding, padding);
+  } else {
+    fill(Color::NONE, block.left, bottom, block.width, padding);
+  }
+  // Left.
+  if (tileable_left) {
+    for (unsigned i = 0; i < padding; ++i)
+      upload(bmp, src_x, src_y, block.left + i, top, 1, src_height);
+  } else {
+    fill(Color::NONE, block.left, top, padding, src_height);
+  }
+  // Right.
+  if (tileable_right) {
+    for (unsigned i = 0; i < padding; ++i)
+      upload(bmp, src_right, src_y, right + i, top, 1, src_height);
+  } else {
+    fill(Color::NONE, right, top, padding, src_height);
+  }
+  return result;
+}
+
+vector<unique_ptr<Gosu::TexChunk>> Gosu::Texture::try_alloc_tiles(const BitmapView& sheet,
+    unsigned tiles_x, unsigned tiles_y, unsigned padding, unsigned image_flags)
+{
+  vector<unique_ptr<TexChunk>> result;
+  BlockAllocator::Block block;
+  if (!alloc(sheet.width(), sheet.height(), block)) return result;
+  ensure_current_context();
+  glBindTexture(GL_TEXTURE_2D, tex_name_);
+  upload(sheet, 0, 0, block.left, block.top, block.width, block.height);
+  // Hand the sheet's block over to the individual cells, so that each one can be freed on its own.
+  free(block.left, block.top, block.width, block.height);
+  unsigned cell_width = sheet.width() / tiles_x, cell_height = sheet.height() / tiles_y;
+  result.reserve(tiles_x * tiles_y);
+  for (unsigned y = 0; y < tiles_y; ++y) {
+    for (unsigned x = 0; x < tiles_x; ++x) {
+      unsigned left = block.left + x * cell_width, top = block.top + y * cell_height;
+      this->block(left, top, cell_width, cell_height);
+      result.emplace_back(new TexChunk(shared_from_this(),
+                                       left        + padding,
+                                       top         + padding,
+                                       cell_width  - 2 * padding,
+                                       cell_height - 2 * padding,
+                                       padding,
+                                       marks_retro(image_flags)));
+    }
+  }
   return result;
 }
 
 void Gosu::Texture::block(unsigned x, unsigned y, unsigned width, unsigned height)
 {
-  allocator_.block(x, y, width, height);
+  unsigned g = granularity();
+  allocator_.block(x / g, y / g, (x + width + g - 1) / g - x / g, (y + height + g - 1) / g - y / g);
 }
 
 void Gosu::Texture::free(unsigned x, unsigned y, unsigned width, unsigned height)
 {
-  allocator_.free(x, y, width, height);
+  unsigned g = granularity();
+  allocator_.free(x / g, y / g, (x + width + g - 1) / g - x / g, (y + height + g - 1) / g - y / g);
 }
 
-Gosu::Bitmap Gosu::Texture::to_bitmap(unsigned x, unsigned y, unsigned width, unsigned height) const
+void Gosu::Texture::replace(const BitmapView& bmp, unsigned src_x, unsigned src_y,
+    unsigned x, unsigned y, unsigned width, unsigned height)
 {
+  if (width == 0 || height == 0) return;
+  bool whole_texture = (x == 0 && y == 0 && width == this->width() && height == this->height());
+  if (shadow_.width() == 0) {
 #ifdef GOSU_IS_OPENGLES
-  // See here for one possible implementation: https://github.com/apitrace/apitrace/issues/70
-  // (Could reuse a lot of code from OffScreenTarget)
-  throw logic_error("Texture::to_bitmap not supported on iOS");
-#else
+    // Compact textures cannot be read back to seed the shadow copy (see begin_readback), so
+    // their pixels are uploaded right away.
+    if (format_ != 0 && !whole_texture) {
+      ensure_current_context();
+      glBindTexture(GL_TEXTURE_2D, tex_name_);
+      upload(bmp, src_x, src_y, x, y, width, height);
+      return;
+    }
+#endif
+    // Nothing needs to be read back if all of it is about to be overwritten anyway.
+    if (whole_texture)
+      shadow_.resize(width, height);
+    else
+      shadow_ = to_bitmap(0, 0, this->width(), this->height());
+  }
+  shadow_.insert(bmp, x, y, src_x, src_y, width, height);
+  // Since the shadow is valid everywhere, the bounding box of two rectangles can be uploaded
+  // instead of both without overwriting anything with stale pixels. Merge the new rectangle with
+  // all that it overlaps or touches, including those that only touch the merged result.
+  unsigned left = x, top = y, right = x + width, bottom = y + height;
+  for (size_t i = 0; i < dirty_.size();) {
+    const BlockAllocator::Block& d = dirty_[i];
+    if (d.left > right || d.top > bottom || d.left + d.width < left || d.top + d.height < top) {
+      ++i;
+      continue;
+    }
+    left   = min(left,   d.left);
+    top    = min(top,    d.top);
+    right  = max(right,  d.left + d.width);
+    bottom = max(bottom, d.top  + d.height);
+    dirty_.erase(dirty_.begin() + i);
+    i = 0;
+  }
+  dirty_.emplace_back(left, top, right - left, bottom - top);
+  // Lots of scattered rectangles, e.g. single pixels, are cheaper to upload as one.
+  if (dirty_.size() > MAX_DIRTY_RECTS) {
+    for (const BlockAllocator::Block& d : dirty_) {
+      left   = min(left,   d.left);
+      top    = min(top,    d.top);
+      right  = max(right,  d.left + d.width);
+      bottom = max(bottom, d.top  + d.height);
+    }
+    dirty_.assign(1, BlockAllocator::Block(left, top, right - left, bottom - top));
+  }
+}
+
+void Gosu::Texture::flush()
+{
+  if (dirty_.empty()) return;
+  ensure_current_context();
+  glBindTexture(GL_TEXTURE_2D, tex_name_);
+  for (const BlockAllocator::Block& d : dirty_) {
+    upload(shadow_, d.left, d.top, d.left, d.top, d.width, d.height);
+    update_mipmaps(d.left, d.top, d.width, d.height);
+  }
+  dirty_.clear();
+}
+
+void Gosu::Texture::release_shadow()
+{
+  flush();
+  Bitmap().swap(shadow_);
+}
+
+void Gosu::Texture::update_mipmaps(unsigned x, unsigned y, unsigned width, unsigned height)
+{
+  if (mip_levels_ == 1) return;
+  // Widen the area to whole blocks of the smallest level.
+  unsigned g = granularity();
+  unsigned left = x / g * g, top = y / g * g;
+  unsigned right = (x + width + g - 1) / g * g, bottom = (y + height + g - 1) / g * g;
+  Bitmap level;
+  if (shadow_.width() != 0)
+    level = Bitmap(BitmapView(shadow_, left, top, right - left, bottom - top));
+  else
+    level = to_bitmap(left, top, right - left, bottom - top);
+  glBindTexture(GL_TEXTURE_2D, tex_name_);
+  upload_mipmaps(move(level), left, top);
+}
+
+bool Gosu::Texture::begin_readback(GLint& previous_framebuffer) const
+{
+  // Only RGBA8 is guaranteed to be color-renderable.
+  if (format_ != 0) return false;
+#ifndef GOSU_IS_IPHONE
+  static bool has_framebuffers = SDL_GL_ExtensionSupported("GL_EXT_framebuffer_object");
+  if (!has_framebuffers) return false;
+#endif
+  GOSU_LOAD_GL_EXT(glGenFramebuffers, PFNGLGENFRAMEBUFFERSPROC);
+  GOSU_LOAD_GL_EXT(glBindFramebuffer, PFNGLBINDFRAMEBUFFERPROC);
+  GOSU_LOAD_GL_EXT(glFramebufferTexture2D, PFNGLFRAMEBUFFERTEXTURE2DPROC);
+  GOSU_LOAD_GL_EXT(glCheckFramebufferStatus, PFNGLCHECKFRAMEBUFFERSTATUSPROC);
+
+  // Readbacks can happen while rendering into an OffScreenTarget, so restore its binding later.
+  glGetIntegerv(GOSU_GL_CONST(GL_FRAMEBUFFER_BINDING), &previous_framebuffer);
+  if (framebuffer_ == 0) {
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GOSU_GL_CONST(GL_FRAMEBUFFER), framebuffer_);
+    glFramebufferTexture2D(GOSU_GL_CONST(GL_FRAMEBUFFER), GOSU_GL_CONST(GL_COLOR_ATTACHMENT0),
+                           GL_TEXTURE_2D, tex_name_, 0);
+  }
+  else {
+    glBindFramebuffer(GOSU_GL_CONST(GL_FRAMEBUFFER), framebuffer_);
+  }
+  GLenum status = glCheckFramebufferStatus(GOSU_GL_CONST(GL_FRAMEBUFFER));
+  if (status != GOSU_GL_CONST(GL_FRAMEBUFFER_COMPLETE)) {
+    end_readback(previous_framebuffer);
+    return false;
+  }
+  return true;
+}
+
+void Gosu::Texture::end_readback(GLint previous_framebuffer) const
+{
+  GOSU_LOAD_GL_EXT(glBindFramebuffer, PFNGLBINDFRAMEBUFFERPROC);
+  glBindFramebuffer(GOSU_GL_CONST(GL_FRAMEBUFFER), previous_framebuffer);
+}
+
+void Gosu::Texture::finish_readback(Bitmap& bitmap) const
+{
+  // Alpha textures read back as black, but are drawn as white. Intensity textures (alpha
+  // textures with premultiplied alpha) read back their coverage as red.
+  if ((format_ & IF_ALPHA8) && Graphics::premultiplied_alpha()) {
+    for (Color& c : bitmap.pixels) c = Color(c.red(), 255, 255, 255);
+  }
+  else if (format_ & IF_ALPHA8) {
+    for (Color& c : bitmap.pixels) c = Color(c.alpha(), 255, 255, 255);
+  }
+  else if (Graphics::premultiplied_alpha()) {
+    for (Color& c : bitmap.pixels) c = unpremultiply(c);
+  }
+}
+
+Gosu::Bitmap Gosu::Texture::to_bitmap(unsigned x, unsigned y, unsigned width, unsigned height) const
+{
+  // Uploading staged pixels does not change what the texture looks like from the outside.
+  const_cast<Texture*>(this)->flush();
   ensure_current_context();
-  Bitmap full_texture(this->width(), this->height());
-  glBindTexture(GL_TEXTURE_2D, tex_name());
-  // TODO: There are ways to retrieve only part of a texture, which we should use sooner or later.
-  glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, full_texture.data());
   Bitmap bitmap(width, height);
-  bitmap.insert(full_texture, -int(x), -int(y));
+  GLint previous_framebuffer;
+  if (begin_readback(previous_framebuffer)) {
+    // Only read the requested rectangle instead of the whole texture.
+    glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, bitmap.data());
+    end_readback(previous_framebuffer);
+  }
+  else {
+#ifdef GOSU_IS_OPENGLES
+    throw logic_error("Texture::to_bitmap needs framebuffer objects on OpenGL ES");
+#else
+    Bitmap full_texture(this->width(), this->height());
+    glBindTexture(GL_TEXTURE_2D, tex_name());
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, full_texture.data());
+    bitmap.insert(full_texture, -int(x), -int(y));
+#endif
+  }
+  finish_readback(bitmap);
   return bitmap;
+}
+
+future<Gosu::Bitmap> Gosu::Texture::to_bitmap_async(unsigned x, unsigned y,
+    unsigned width, unsigned height) const
+{
+  const_cast<Texture*>(this)->flush();
+#ifndef GOSU_IS_OPENGLES
+  ensure_current_context();
+  static bool has_pixel_buffers = SDL_GL_ExtensionSupported("GL_ARB_pixel_buffer_object");
+  GLint previous_framebuffer;
+  if (has_pixel_buffers && begin_readback(previous_framebuffer)) {
+    GOSU_LOAD_GL_EXT(glGenBuffers, PFNGLGENBUFFERSPROC);
+    GOSU_LOAD_GL_EXT(glBindBuffer, PFNGLBINDBUFFERPROC);
+    GOSU_LOAD_GL_EXT(glBufferData, PFNGLBUFFERDATAPROC);
+
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, width * height * sizeof(Color), nullptr, GL_STREAM_READ);
+    // With a pack buffer bound, this only queues the copy and returns.
+    glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    end_readback(previous_framebuffer);
+
+    shared_ptr<const Texture> self = shared_from_this();
+    // The buffer goes away with the future's shared state, whether get() is called or not.
+    shared_ptr<PixelPackBuffer> owner = make_shared<PixelPackBuffer>(buffer);
+    return async(launch::deferred, [self, owner, width, height] {
+      GOSU_LOAD_GL_EXT(glBindBuffer, PFNGLBINDBUFFERPROC);
+      GOSU_LOAD_GL_EXT(glMapBuffer, PFNGLMAPBUFFERPROC);
+      GOSU_LOAD_GL_EXT(glUnmapBuffer, PFNGLUNMAPBUFFERPROC);
+
+      ensure_current_context();
+      Bitmap bitmap(width, height);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, owner->name);
+      if (const void* pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY)) {
+        memcpy(bitmap.data(), pixels, width * height * sizeof(Color));
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      }
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+      self->finish_readback(bitmap);
+      return bitmap;
+    });
+  }
 #endif
+  // Without pixel buffer objects, there is nothing to gain from waiting.
+  promise<Bitmap> result;
+  result.set_value(to_bitmap(x, y, width, height));
+  return result.get_future();
 }
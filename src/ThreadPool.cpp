@@ -0,0 +1,144 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace Gosu
+{
+  namespace
+  {
+    // Set on the pool's own threads, so that nested parallel_for calls cannot deadlock.
+    thread_local bool is_worker = false;
+
+    class ThreadPool
+    {
+      vector<thread> workers;
+      mutex task_mutex;
+      condition_variable task_added;
+      // Chunks of parallel_for calls, which someone is waiting for, go before background tasks.
+      deque<function<void ()>> urgent_tasks, background_tasks;
+      bool stopping = false;
+
+      void work()
+      {
+        is_worker = true;
+        for (;;) {
+          function<void ()> task;
+          {
+            unique_lock<mutex> lock(task_mutex);
+            task_added.wait(lock, [this] {
+              return stopping || !urgent_tasks.empty() || !background_tasks.empty();
+            });
+            // Pending tasks are dropped. parallel_for does not depend on them, see below.
+            if (stopping) return;
+            deque<function<void ()>>& tasks =
+              urgent_tasks.empty() ? background_tasks : urgent_tasks;
+            task = move(tasks.front());
+            tasks.pop_front();
+          }
+          task();
+        }
+      }
+
+    public:
+      ThreadPool()
+      {
+        // The thread that calls parallel_for does its share of the work, too.
+        unsigned count = max(2u, thread::hardware_concurrency()) - 1;
+        for (unsigned i = 0; i < count; ++i)
+          workers.emplace_back([this] { work(); });
+      }
+
+      ~ThreadPool()
+      {
+        {
+          lock_guard<mutex> lock(task_mutex);
+          stopping = true;
+        }
+        task_added.notify_all();
+        for (thread& worker : workers) worker.join();
+      }
+
+      unsigned size() const
+      {
+        return static_cast<unsigned>(workers.size());
+      }
+
+      void submit(function<void ()> task, bool urgent)
+      {
+        {
+          lock_guard<mutex> lock(task_mutex);
+          (urgent ? urgent_tasks : background_tasks).push_back(move(task));
+        }
+        task_added.notify_one();
+      }
+    };
+
+    ThreadPool& pool()
+    {
+      static ThreadPool instance;
+      return instance;
+    }
+  }
+}
+
+void Gosu::parallel_for(unsigned count, unsigned min_chunk,
+                        const function<void (unsigned begin, unsigned end)>& f)
+{
+  if (count == 0) return;
+  unsigned chunks = is_worker ? 1 : min(pool().size() + 1, count / max(1u, min_chunk));
+  if (chunks <= 1) {
+    f(0, count);
+    return;
+  }
+
+  // Chunks are claimed by whoever gets to them first. The calling thread keeps claiming chunks
+  // after its own, so it never waits for workers that are still busy with background tasks;
+  // tasks that start after all chunks have been claimed do nothing, and never touch f.
+  struct Progress
+  {
+    atomic<unsigned> next_chunk;
+    mutex m;
+    condition_variable finished;
+    unsigned remaining;
+    exception_ptr error;
+  };
+  auto progress = make_shared<Progress>();
+  progress->next_chunk = 0;
+  progress->remaining = chunks;
+  auto run_chunks = [progress, &f, count, chunks] {
+    for (;;) {
+      unsigned i = progress->next_chunk++;
+      if (i >= chunks) return;
+      unsigned begin = static_cast<unsigned long long>(count) * i / chunks;
+      unsigned end = static_cast<unsigned long long>(count) * (i + 1) / chunks;
+      exception_ptr error;
+      try {
+        f(begin, end);
+      } catch (...) {
+        error = current_exception();
+      }
+      lock_guard<mutex> lock(progress->m);
+      if (error && !progress->error) progress->error = error;
+      if (--progress->remaining == 0) progress->finished.notify_one();
+    }
+  };
+  for (unsigned i = 1; i < chunks; ++i) pool().submit(run_chunks, true);
+  run_chunks();
+
+  unique_lock<mutex> lock(progress->m);
+  progress->finished.wait(lock, [&] { return progress->remaining == 0; });
+  if (progress->error) rethrow_exception(progress->error);
+}
+
+void Gosu::run_in_background(function<void ()> f)
+{
+  pool().submit(move(f), false);
+}
@@ -156,35 +156,8 @@ struct Gosu::TrueTypeFont::Impl
     void blend_into_bitmap(Bitmap& bitmap, const unsigned char* pixels, int x, int y, int w, int h,
                            Color c)
     {
-        int stride = w;
-        
-        // Instead of transferring all pixels in the range [0; w) x [0; h) into the bitmap, clip
-        // these values because Bitmap::blend_pixel does not perform bounds checking.
-        
-        int src_x = 0;
-        if (x < 0) {
-            src_x -= x;
-            w += x;
-            x = 0;
-        }
-        
-        int src_y = 0;
-        if (y < 0) {
-            src_y -= y;
-            h += y;
-            y = 0;
-        }
-        
-        w = min<int>(w, bitmap.width() - x);
-        h = min<int>(h, bitmap.height() - y);
-        
-        for (int rel_y = 0; rel_y < h; ++rel_y) {
-            for (int rel_x = 0; rel_x < w; ++rel_x) {
-                int pixel = pixels[(src_y + rel_y) * stride + src_x + rel_x];
-                Color c_with_alpha(pixel * c.alpha() / 255, c.red(), c.green(), c.blue());
-                bitmap.blend_pixel(x + rel_x, y + rel_y, c_with_alpha);
-            }
-        }
+        // Bitmap::blend_mask clips the glyph and scales the color's alpha by its coverage.
+        bitmap.blend_mask(pixels, w, x, y, w, h, c);
     }
 };
 
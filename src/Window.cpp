@@ -2,6 +2,7 @@
 #if !defined(GOSU_IS_IPHONE)
 
 #include "Gosu.hpp"
+#include "FrameCapture.hpp"
 #include "GraphicsImpl.hpp"
 #include <SDL.h>
 #include <SDL_image.h>
@@ -89,6 +90,8 @@ struct Gosu::Window::Impl
   enum { CLOSED, OPEN, CLOSING } state = CLOSED;
   unique_ptr<Graphics> graphics;
   unique_ptr<Input> input;
+  // Created when the first screenshot or recording is requested.
+  unique_ptr<FrameCapture> capture;
 };
 
 Gosu::Window::Window(unsigned width, unsigned height, bool fullscreen, double update_interval)
@@ -288,6 +291,11 @@ bool Gosu::Window::tick()
         draw();
         FPS::register_frame();
     });
+    if (pimpl->capture) {
+      int width, height;
+      SDL_GL_GetDrawableSize(shared_window(), &width, &height);
+      pimpl->capture->capture(width, height);
+    }
     SDL_GL_SwapWindow(shared_window());
   }
   if (pimpl->state == Impl::CLOSING)
@@ -299,37 +307,29 @@ void Gosu::Window::save_screenshot(const std::string &format)
 {
   time_t rt = time(NULL);
   char filename[120];
-  size_t surface_len = width() * height() * sizeof(uint8_t);//surface->format->BytesPerPixel
-  unsigned char *pixels = new unsigned char[surface_len];
   tm *tmp = localtime(&rt);
   sprintf(filename, "Screenshots/shot_%d-%02d-%02d_%02d%02d%02d.%s", tmp->tm_year+1900,
       tmp->tm_mon+1, tmp->tm_mday, tmp->tm_hour, tmp->tm_min, tmp->tm_sec, format.c_str());
-  SDL_Surface* surface = SDL_GetWindowSurface(shared_window());
-  SDL_LockSurface(surface);
-  if (!surface) {
-    printf("Error: No valid surface could be found.");
-    SDL_FreeSurface(surface);
-    return;
-  }
-  //Gosu::save_image_file(filename, width(), height(), pixels);
-  //SDL_FreeSurface(surface);
-  //if (format == "bmp") {
-    //if ( IMG_SaveBMP(surface, filename) != 0 )
-    //  Debug() << "Freeing BMP surface after failure";
-  if (format == "jpg") {
-    if ( IMG_SaveJPG(surface, filename, 95) != 0 )
-      Debug() << "Freeing JPG surface after failure";
-  } else {
-    if ( IMG_SavePNG(surface, filename) != 0 )
-      Debug() << "Freeing PNG surface after failure";
-  }//
-  delete[] pixels;
-  Debug() << "Sent data to Bitmap";
-  //Bitmap bmp;
-  //bmp.resize(width(), height());
-  //Gosu::Color *bytes = bmp.data();
-  //memcpy(bytes, pixels, surface_len);
-  //Gosu::save_image_file(bmp, filename);
+  // The next frame is read back without stalling, and encoded on a background thread.
+  if (!pimpl->capture) pimpl->capture.reset(new FrameCapture);
+  pimpl->capture->save_next_frame(filename);
+}
+
+void Gosu::Window::start_recording(const std::string& filename)
+{
+  if (!pimpl->capture) pimpl->capture.reset(new FrameCapture);
+  unsigned fps = max(1, static_cast<int>(1000 / update_interval() + 0.5));
+  pimpl->capture->start_recording(filename, fps);
+}
+
+void Gosu::Window::stop_recording()
+{
+  if (pimpl->capture) pimpl->capture->stop_recording();
+}
+
+bool Gosu::Window::recording() const
+{
+  return pimpl->capture && pimpl->capture->recording();
 }
 
 void Gosu::Window::close()